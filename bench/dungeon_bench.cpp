@@ -0,0 +1,468 @@
+// Микробенчмарки горячих путей (Google Benchmark).
+// Размер задачи — число NPC (от 1e2 до 1e6, где это разумно по времени).
+// Результаты в JSON для сравнения между коммитами:
+//   ./dungeon_bench --benchmark_out=bench.json --benchmark_out_format=json
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "NPCFactory.h"
+#include "BattleVisitor.h"
+#include "BattleQueue.h"
+#include "RingBattleQueue.h"
+#include "BattleRounds.h"
+#include "AsyncFileObserver.h"
+#include "DungeonEditor.h"
+#include "Observer.h"
+#include "SpatialHashGrid.h"
+#include "DensityHeatmap.h"
+#include "Metrics.h"
+
+namespace
+{
+    const char *const TYPES[] = {"Knight", "Druid", "Elf"};
+
+    // Сторона карты с той же плотностью, что и в асинхронной игре (50 NPC на 100x100)
+    double mapSideFor(size_t count)
+    {
+        return std::sqrt((double)count * 200.0);
+    }
+
+    std::vector<std::shared_ptr<NPC>> makeNPCs(size_t count, double side, uint32_t seed = 1)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<double> pos(0.0, side);
+        std::uniform_int_distribution<int> type(0, 2);
+
+        std::vector<std::shared_ptr<NPC>> npcs;
+        npcs.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            npcs.push_back(NPCFactory::createNPC(TYPES[type(rng)], "B" + std::to_string(i), pos(rng), pos(rng)));
+        }
+        return npcs;
+    }
+
+    // Прежняя реализация accept(): до трёх dynamic_cast на каждого участника
+    void legacyAccept(NPC &attacker, Visitor &visitor, NPC &defender)
+    {
+        if (auto *a = dynamic_cast<Knight *>(&attacker))
+        {
+            if (auto *k = dynamic_cast<Knight *>(&defender))
+                visitor.visitKnight(*a, *k);
+            else if (auto *d = dynamic_cast<Druid *>(&defender))
+                visitor.visitKnight(*a, *d);
+            else if (auto *e = dynamic_cast<Elf *>(&defender))
+                visitor.visitKnight(*a, *e);
+        }
+        else if (auto *a = dynamic_cast<Druid *>(&attacker))
+        {
+            if (auto *k = dynamic_cast<Knight *>(&defender))
+                visitor.visitDruid(*a, *k);
+            else if (auto *d = dynamic_cast<Druid *>(&defender))
+                visitor.visitDruid(*a, *d);
+            else if (auto *e = dynamic_cast<Elf *>(&defender))
+                visitor.visitDruid(*a, *e);
+        }
+        else if (auto *a = dynamic_cast<Elf *>(&attacker))
+        {
+            if (auto *k = dynamic_cast<Knight *>(&defender))
+                visitor.visitElf(*a, *k);
+            else if (auto *d = dynamic_cast<Druid *>(&defender))
+                visitor.visitElf(*a, *d);
+            else if (auto *e = dynamic_cast<Elf *>(&defender))
+                visitor.visitElf(*a, *e);
+        }
+    }
+
+    class NullObserver : public Observer
+    {
+    public:
+        void onKill(const std::string &, const std::string &) override {}
+        void onKillEvent(const KillEvent &event) override { benchmark::DoNotOptimize(event.tick); }
+    };
+}
+
+// NPC::distanceTo для соседних по списку пар
+static void BM_DistanceTo(benchmark::State &state)
+{
+    const size_t n = (size_t)state.range(0);
+    auto npcs = makeNPCs(n, mapSideFor(n));
+    for (auto _ : state)
+    {
+        double sum = 0;
+        for (size_t i = 0; i + 1 < n; ++i)
+            sum += npcs[i]->distanceTo(*npcs[i + 1]);
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)(n - 1));
+}
+BENCHMARK(BM_DistanceTo)->RangeMultiplier(10)->Range(100, 1000000);
+
+// Поиск пар на расстоянии убийства полным перебором, O(n^2)
+static void BM_CollisionPairsBrute(benchmark::State &state)
+{
+    const size_t n = (size_t)state.range(0);
+    auto npcs = makeNPCs(n, mapSideFor(n));
+    std::vector<double> xs(n), ys(n), ranges(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        xs[i] = npcs[i]->getX();
+        ys[i] = npcs[i]->getY();
+        ranges[i] = npcs[i]->getKillRange();
+    }
+
+    for (auto _ : state)
+    {
+        size_t pairs = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            for (size_t j = i + 1; j < n; ++j)
+            {
+                double dx = xs[i] - xs[j], dy = ys[i] - ys[j];
+                double r = std::max(ranges[i], ranges[j]);
+                pairs += dx * dx + dy * dy <= r * r;
+            }
+        }
+        benchmark::DoNotOptimize(pairs);
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)n);
+}
+BENCHMARK(BM_CollisionPairsBrute)->RangeMultiplier(10)->Range(100, 10000);
+
+// Тот же поиск через SpatialHashGrid: перестроение сетки и пары в радиусе
+static void BM_CollisionPairsGrid(benchmark::State &state)
+{
+    const size_t n = (size_t)state.range(0);
+    auto npcs = makeNPCs(n, mapSideFor(n));
+    std::vector<double> xs(n), ys(n), ranges(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        xs[i] = npcs[i]->getX();
+        ys[i] = npcs[i]->getY();
+        ranges[i] = npcs[i]->getKillRange();
+    }
+
+    SpatialHashGrid grid(*std::max_element(ranges.begin(), ranges.end()));
+    for (auto _ : state)
+    {
+        grid.build(xs, ys, ranges);
+        benchmark::DoNotOptimize(grid.pairsWithinRange().size());
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)n);
+}
+BENCHMARK(BM_CollisionPairsGrid)->RangeMultiplier(10)->Range(100, 1000000);
+
+// Бой через accept(): табличная диспетчеризация KILL_RULES
+static void BM_AcceptDispatch(benchmark::State &state)
+{
+    const size_t n = (size_t)state.range(0);
+    auto npcs = makeNPCs(n, 100.0);
+    Subject subject;
+    BattleVisitor visitor(subject, (uint64_t)1);
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        npcs[i % n]->accept(visitor, *npcs[(i * 7 + 1) % n]);
+        ++i;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AcceptDispatch)->RangeMultiplier(10)->Range(100, 1000000);
+
+// Для сравнения: прежняя цепочка dynamic_cast
+static void BM_LegacyDispatch(benchmark::State &state)
+{
+    const size_t n = (size_t)state.range(0);
+    auto npcs = makeNPCs(n, 100.0);
+    Subject subject;
+    BattleVisitor visitor(subject, (uint64_t)1);
+
+    size_t i = 0;
+    for (auto _ : state)
+    {
+        legacyAccept(*npcs[i % n], visitor, *npcs[(i * 7 + 1) % n]);
+        ++i;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LegacyDispatch)->RangeMultiplier(10)->Range(100, 1000000);
+
+// Очередь боёв: каждый поток кладёт пакет задач и забирает столько же.
+// Потоки одновременно производители и потребители (1..8).
+template <class Queue>
+static void BM_BattleQueuePushPop(benchmark::State &state)
+{
+    static Queue *queue = nullptr;
+    static std::vector<std::shared_ptr<NPC>> npcs;
+    const size_t batchSize = 64;
+
+    if (state.thread_index() == 0)
+    {
+        queue = new Queue();
+        npcs = makeNPCs(2 * batchSize, 100.0);
+    }
+
+    std::vector<BattleTask> batch(batchSize, BattleTask(nullptr, nullptr));
+    for (auto _ : state)
+    {
+        for (size_t k = 0; k < batchSize; ++k)
+            batch[k] = BattleTask(npcs[2 * k], npcs[2 * k + 1]);
+        queue->push_n(batch.data(), batchSize);
+
+        size_t popped = 0;
+        while (popped < batchSize)
+            popped += queue->pop_n(batch.data(), batchSize - popped);
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)batchSize);
+
+    if (state.thread_index() == 0)
+    {
+        delete queue;
+        queue = nullptr;
+    }
+}
+BENCHMARK_TEMPLATE(BM_BattleQueuePushPop, BattleQueue)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_BattleQueuePushPop, RingBattleQueue)->ThreadRange(1, 8)->UseRealTime();
+
+// Бои одного тика потоками боёв, как в Game::step: пары раскладываются по
+// раундам BattleRounds, раунд ставится в очередь и делится между потоками,
+// убийства идут через Subject в AsyncFileObserver. Аргумент — число потоков.
+// NPC пересоздаются между итерациями вне замера
+static void BM_BattleWorkers(benchmark::State &state)
+{
+    const size_t npcCount = 20000, pairCount = 100000;
+    const size_t workers = (size_t)state.range(0);
+    const char *const logName = "bench_battle_log.txt";
+
+    BattleQueue queue(false);
+    Subject subject;
+    auto log = std::make_shared<AsyncFileObserver>(logName);
+    subject.attach(log);
+    std::atomic<uint64_t> handled{0};
+    std::atomic<size_t> share{64};
+    std::mutex doneMutex;
+    std::condition_variable done;
+
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < workers; ++w)
+    {
+        threads.emplace_back([&]
+                             {
+            BattleVisitor visitor(subject, 1);
+            std::vector<BattleTask> batch(64, BattleTask(nullptr, nullptr));
+            size_t count;
+            while ((count = queue.pop_n(batch.data(), share.load(std::memory_order_relaxed))) > 0)
+            {
+                for (size_t k = 0; k < count; ++k)
+                {
+                    const BattleTask &task = batch[k];
+                    if (task.attacker->isAlive() && task.defender->isAlive())
+                    {
+                        visitor.setBattleContext(task.epoch,
+                                                 BattleVisitor::pairKey(task.attackerHandle, task.defenderHandle));
+                        task.attacker->accept(visitor, *task.defender);
+                    }
+                }
+                if (handled.fetch_add(count, std::memory_order_release) + count >= queue.stats().enqueued)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(doneMutex);
+                    }
+                    done.notify_all();
+                }
+            } });
+    }
+
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<uint32_t> pick(0, (uint32_t)npcCount - 1);
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    while (pairs.size() < pairCount)
+    {
+        uint32_t a = pick(rng), b = pick(rng);
+        if (a != b)
+            pairs.emplace_back(a, b);
+    }
+
+    std::vector<std::shared_ptr<NPC>> npcs;
+    std::vector<BattleTask> tasks;
+    BattleRounds rounds;
+    uint64_t tick = 0;
+    size_t totalRounds = 0;
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        npcs = makeNPCs(npcCount, 100.0, (uint32_t)tick);
+        for (const auto &pair : pairs)
+            tasks.emplace_back(npcs[pair.first].get(), npcs[pair.second].get(), pair.first, pair.second, tick);
+        state.ResumeTiming();
+
+        rounds.plan(tasks);
+        for (size_t r = 0; r < rounds.rounds(); ++r)
+        {
+            size_t size = rounds.roundSize(r);
+            share.store(std::min<size_t>((size + workers - 1) / workers, 64), std::memory_order_relaxed);
+            queue.push_n(rounds.round(r), size);
+            std::unique_lock<std::mutex> lock(doneMutex);
+            done.wait(lock, [&]
+                      { return handled.load(std::memory_order_acquire) >= queue.stats().enqueued; });
+        }
+        totalRounds += rounds.rounds();
+        ++tick;
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)pairCount);
+    state.counters["rounds"] = (double)totalRounds / (double)std::max<uint64_t>(1, tick);
+
+    queue.stop();
+    for (auto &thread : threads)
+        thread.join();
+    log->stop();
+    std::remove(logName);
+}
+BENCHMARK(BM_BattleWorkers)->RangeMultiplier(2)->Range(1, 8)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// Создание и уничтожение NPC пакетами (оборот спавна и гибели);
+// аргумент — способ выделения памяти (0 make_shared, 1 слэбы)
+static void BM_CreateDestroyNPC(benchmark::State &state)
+{
+    const size_t n = (size_t)state.range(0);
+    NPCFactory::setAllocation(state.range(1) ? NPCAllocation::Pool : NPCAllocation::Heap);
+    const NameId name = NameTable::global().intern("Churn");
+    std::vector<std::shared_ptr<NPC>> npcs(n);
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < n; ++i)
+            npcs[i] = NPCFactory::createNPC((NPCType)(i % 3), name, (double)i, 0.0, (NPCId)i);
+        for (auto &npc : npcs)
+            npc.reset();
+    }
+    NPCFactory::setAllocation(NPCAllocation::Heap);
+    state.SetItemsProcessed(state.iterations() * (int64_t)n);
+}
+BENCHMARK(BM_CreateDestroyNPC)->ArgsProduct({{1000, 100000}, {0, 1}});
+
+// Разбор строк файла сохранения
+static void BM_CreateFromString(benchmark::State &state)
+{
+    const size_t n = (size_t)state.range(0);
+    std::vector<std::string> lines;
+    lines.reserve(n);
+    for (const auto &npc : makeNPCs(n, 500.0))
+        lines.push_back(npc->serialize());
+
+    for (auto _ : state)
+    {
+        for (const auto &line : lines)
+            benchmark::DoNotOptimize(NPCFactory::createFromString(line));
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)n);
+}
+BENCHMARK(BM_CreateFromString)->RangeMultiplier(10)->Range(100, 1000000);
+
+// Сохранение и загрузка редактора через файл; второй аргумент — формат (0 текст, 1 двоичный)
+static void BM_SaveLoad(benchmark::State &state)
+{
+    const size_t n = (size_t)state.range(0);
+    const SaveFormat format = state.range(1) ? SaveFormat::Binary : SaveFormat::Text;
+    const std::string file = "dungeon_bench_save.dat";
+
+    DungeonEditor editor;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> pos(0.0, 500.0);
+    for (size_t i = 0; i < n; ++i)
+        editor.addNPC(TYPES[i % 3], "S" + std::to_string(i), pos(rng), pos(rng));
+
+    DungeonEditor loaded;
+    for (auto _ : state)
+    {
+        editor.saveToFile(file, format);
+        loaded.loadFromFile(file);
+    }
+    std::remove(file.c_str());
+    state.SetItemsProcessed(state.iterations() * (int64_t)n);
+}
+BENCHMARK(BM_SaveLoad)->ArgsProduct({{100, 1000, 10000}, {0, 1}})->Unit(benchmark::kMillisecond);
+
+// Построение карты редактора пакетом addNPCs (проверка имён через индекс)
+static void BM_EditorAddNPCs(benchmark::State &state)
+{
+    const size_t n = (size_t)state.range(0);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> pos(0.0, 500.0);
+    std::vector<NPCSpec> specs;
+    specs.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+        specs.push_back({TYPES[i % 3], "A" + std::to_string(i), pos(rng), pos(rng)});
+
+    for (auto _ : state)
+    {
+        DungeonEditor editor;
+        benchmark::DoNotOptimize(editor.addNPCs(specs));
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)n);
+}
+BENCHMARK(BM_EditorAddNPCs)->RangeMultiplier(10)->Range(100, 100000)->Unit(benchmark::kMillisecond);
+
+// Рассылка события убийства наблюдателям
+static void BM_SubjectNotify(benchmark::State &state)
+{
+    Subject subject;
+    for (int64_t i = 0; i < state.range(0); ++i)
+        subject.attach(std::make_shared<NullObserver>());
+
+    KillEvent event{0, 1, 0, 1, NPCType::Knight, NPCType::Elf, 6, 1, false, 0};
+    for (auto _ : state)
+    {
+        ++event.tick;
+        subject.notify(event);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SubjectNotify)->RangeMultiplier(4)->Range(1, 64);
+
+// Подсчёт карты плотности по снимку мира; второй аргумент — число потоков
+static void BM_HeatmapBuild(benchmark::State &state)
+{
+    const size_t n = (size_t)state.range(0);
+    const double side = mapSideFor(n);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> pos(0.0, side);
+    WorldSnapshot snapshot;
+    for (size_t i = 0; i < n; ++i)
+    {
+        snapshot.xs.push_back(pos(rng));
+        snapshot.ys.push_back(pos(rng));
+        snapshot.types.push_back((NPCType)(i % NPC_TYPE_COUNT));
+        snapshot.nameIds.push_back(0);
+        snapshot.alives.push_back(1);
+    }
+
+    DensityHeatmap heatmap(64, 32, side, side);
+    for (auto _ : state)
+    {
+        heatmap.build(snapshot, (unsigned)state.range(1));
+        benchmark::DoNotOptimize(heatmap.maxCellTotal());
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)n);
+}
+BENCHMARK(BM_HeatmapBuild)->ArgsProduct({{10000, 1000000}, {1, 4}})->UseRealTime();
+
+// Счётчик метрик из нескольких потоков: каждый пишет в свой сегмент
+static void BM_MetricsCounterAdd(benchmark::State &state)
+{
+    static Counter counter;
+    for (auto _ : state)
+        counter.add();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MetricsCounterAdd)->ThreadRange(1, 8)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,302 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Observer.h"
+
+// Асинхронный Observer для записи в файл.
+// onKillEvent() только копирует POD-событие в lock-free кольцевой буфер
+// (много производителей / один потребитель) и сразу возвращается.
+// Фоновый поток держит файл открытым, форматирует события и пишет их
+// пакетами: по достижении flushBytes или раз в flushInterval.
+// Если буфер заполнен, событие отбрасывается и учитывается в dropped().
+// Деструктор дописывает всё, что успело попасть в буфер.
+class AsyncFileObserver : public Observer
+{
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence{0};
+        KillEvent event{};
+        std::string text; // Готовый текст для onKill(); пусто — форматировать event
+    };
+
+    struct alignas(64) Position
+    {
+        std::atomic<size_t> value{0};
+    };
+
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    Position enqueuePos;
+    Position dequeuePos; // Пишет только поток записи
+
+    const size_t flushBytes;
+    const std::chrono::milliseconds flushInterval;
+    std::ofstream file;
+
+    std::atomic<bool> stopped{false};
+    // Производители внутри enqueue(); поток записи не завершается, пока их не станет 0
+    std::atomic<int> inFlight{0};
+    std::atomic<uint64_t> acceptedCount{0};
+    std::atomic<uint64_t> droppedCount{0};
+    std::atomic<uint64_t> writtenCount{0};
+    std::atomic<uint64_t> flushRequests{0};
+    std::atomic<bool> writerSleeping{false};
+    bool writerDone = false; // Под wait_mutex
+
+    std::mutex wait_mutex;
+    std::condition_variable writerCv;  // Будит поток записи
+    std::condition_variable flushedCv; // Сообщает flush() о записи на диск
+    std::thread writer;
+
+    static size_t roundUpPow2(size_t n)
+    {
+        size_t p = 2;
+        while (p < n)
+            p <<= 1;
+        return p;
+    }
+
+    // fill(cell) заполняет захваченную ячейку
+    template <class Fill>
+    bool tryPush(Fill &&fill)
+    {
+        size_t pos = enqueuePos.value.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0)
+            {
+                if (enqueuePos.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    fill(cell);
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // Буфер заполнен
+            }
+            else
+            {
+                pos = enqueuePos.value.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Забрать одну строку в batch; единственный потребитель — без CAS
+    bool tryPop(std::string &batch)
+    {
+        size_t pos = dequeuePos.value.load(std::memory_order_relaxed);
+        Cell &cell = cells[pos & mask];
+        size_t seq = cell.sequence.load(std::memory_order_acquire);
+        if (seq != pos + 1)
+        {
+            return false;
+        }
+        if (cell.text.empty())
+        {
+            batch += formatKiller(cell.event);
+            batch += " убил(а) ";
+            batch += formatVictim(cell.event);
+            batch += '\n';
+        }
+        else
+        {
+            batch += cell.text;
+            cell.text.clear();
+        }
+        cell.sequence.store(pos + mask + 1, std::memory_order_release);
+        dequeuePos.value.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    template <class Fill>
+    void enqueue(Fill &&fill)
+    {
+        // Сначала объявляем себя, потом смотрим на stopped: либо stop() увидит
+        // производителя в inFlight, либо производитель увидит stopped
+        inFlight.fetch_add(1, std::memory_order_seq_cst);
+        if (stopped.load(std::memory_order_seq_cst) || !tryPush(fill))
+        {
+            droppedCount.fetch_add(1, std::memory_order_relaxed);
+            inFlight.fetch_sub(1, std::memory_order_release);
+            return;
+        }
+        acceptedCount.fetch_add(1, std::memory_order_release);
+        inFlight.fetch_sub(1, std::memory_order_release);
+
+        // Будим спящий поток записи только при заполнении буфера наполовину
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (writerSleeping.load(std::memory_order_relaxed) && depth() > mask / 2)
+        {
+            std::lock_guard<std::mutex> lock(wait_mutex);
+            writerCv.notify_one();
+        }
+    }
+
+    void writeBatch(std::string &batch, uint64_t lines)
+    {
+        if (!batch.empty())
+        {
+            file.write(batch.data(), (std::streamsize)batch.size());
+            file.flush();
+            batch.clear();
+        }
+        {
+            std::lock_guard<std::mutex> lock(wait_mutex);
+            writtenCount.fetch_add(lines, std::memory_order_release);
+        }
+        flushedCv.notify_all();
+    }
+
+    void writerLoop()
+    {
+        std::string batch;
+        uint64_t pending = 0;
+        uint64_t handledFlushes = 0;
+        auto lastFlush = std::chrono::steady_clock::now();
+
+        while (true)
+        {
+            while (batch.size() < flushBytes && tryPop(batch))
+            {
+                ++pending;
+            }
+
+            bool stopping = stopped.load(std::memory_order_acquire);
+            uint64_t requests = flushRequests.load(std::memory_order_acquire);
+            auto now = std::chrono::steady_clock::now();
+            if (batch.size() >= flushBytes || now - lastFlush >= flushInterval ||
+                requests != handledFlushes || stopping)
+            {
+                // При остановке и flush() сначала выбираем всё, что уже в буфере
+                if (batch.size() < flushBytes && (stopping || requests != handledFlushes))
+                {
+                    while (tryPop(batch))
+                        ++pending;
+                }
+                writeBatch(batch, pending);
+                pending = 0;
+                handledFlushes = requests;
+                lastFlush = now;
+                // Завершаемся, только когда ни один производитель не может дописать
+                // в буфер после последней выборки
+                if (stopping && inFlight.load(std::memory_order_seq_cst) == 0 && depth() == 0)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(wait_mutex);
+                        writerDone = true;
+                    }
+                    flushedCv.notify_all();
+                    return;
+                }
+                if (stopping)
+                {
+                    std::this_thread::yield(); // Производитель дописывает ячейку
+                }
+                continue;
+            }
+
+            if (batch.size() < flushBytes && depth() == 0)
+            {
+                std::unique_lock<std::mutex> lock(wait_mutex);
+                writerSleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                writerCv.wait_until(lock, lastFlush + flushInterval, [this, handledFlushes]
+                                    { return stopped.load(std::memory_order_acquire) ||
+                                             flushRequests.load(std::memory_order_acquire) != handledFlushes ||
+                                             depth() > mask / 2; });
+                writerSleeping.store(false, std::memory_order_relaxed);
+            }
+        }
+    }
+
+public:
+    explicit AsyncFileObserver(const std::string &filename, size_t capacity = 8192,
+                               size_t flushBytes = 64 * 1024,
+                               std::chrono::milliseconds flushInterval = std::chrono::milliseconds(200))
+        : mask(roundUpPow2(capacity) - 1), cells(new Cell[mask + 1]), flushBytes(flushBytes),
+          flushInterval(flushInterval), file(filename, std::ios::app | std::ios::binary)
+    {
+        for (size_t i = 0; i <= mask; ++i)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        writer = std::thread(&AsyncFileObserver::writerLoop, this);
+    }
+
+    ~AsyncFileObserver() override
+    {
+        stop();
+    }
+
+    AsyncFileObserver(const AsyncFileObserver &) = delete;
+    AsyncFileObserver &operator=(const AsyncFileObserver &) = delete;
+
+    void onKillEvent(const KillEvent &event) override
+    {
+        enqueue([&event](Cell &cell)
+                { cell.event = event; });
+    }
+
+    void onKill(const std::string &killer, const std::string &victim) override
+    {
+        std::string line = killer + " убил(а) " + victim + "\n";
+        enqueue([&line](Cell &cell)
+                { cell.text = std::move(line); });
+    }
+
+    // Дождаться записи на диск всех принятых к этому моменту событий
+    void flush()
+    {
+        uint64_t target = acceptedCount.load(std::memory_order_acquire);
+        std::unique_lock<std::mutex> lock(wait_mutex);
+        flushRequests.fetch_add(1, std::memory_order_release);
+        writerCv.notify_one();
+        flushedCv.wait(lock, [this, target]
+                       { return writtenCount.load(std::memory_order_acquire) >= target || writerDone; });
+    }
+
+    // Остановка: дописать буфер, закрыть файл и завершить поток записи
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(wait_mutex);
+            stopped.store(true, std::memory_order_seq_cst);
+        }
+        writerCv.notify_one();
+        if (writer.joinable())
+        {
+            writer.join();
+        }
+        if (file.is_open())
+        {
+            file.close();
+        }
+    }
+
+    // Число событий в буфере, ещё не забранных потоком записи
+    size_t depth() const
+    {
+        size_t enq = enqueuePos.value.load(std::memory_order_acquire);
+        size_t deq = dequeuePos.value.load(std::memory_order_acquire);
+        return enq > deq ? enq - deq : 0;
+    }
+
+    uint64_t accepted() const { return acceptedCount.load(std::memory_order_relaxed); }
+    uint64_t written() const { return writtenCount.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+    bool isOpen() const { return file.is_open(); }
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "EntityStore.h"
+
+// Таблица владения NPC для параллельных потоков боёв.
+// Перед боем поток захватывает обоих участников; если хотя бы один уже
+// занят другим потоком, захват откатывается и бой откладывается.
+// Так два боя с общим NPC никогда не идут одновременно, и NPC не может
+// быть убит дважды — без опоры на мьютексы самих NPC.
+// Поток держит не больше одной пары захватов, поэтому взаимных блокировок нет.
+// Ячейка таблицы — слот дескриптора (EntityStore::slotOf).
+class BattleClaims
+{
+private:
+    std::unique_ptr<std::atomic<uint8_t>[]> owned;
+    size_t count = 0;
+
+    bool claim(EntityHandle handle)
+    {
+        uint8_t expected = 0;
+        return owned[EntityStore::slotOf(handle)].compare_exchange_strong(expected, 1, std::memory_order_acquire);
+    }
+
+    void release(EntityHandle handle)
+    {
+        owned[EntityStore::slotOf(handle)].store(0, std::memory_order_release);
+    }
+
+public:
+    // Число слотов, которые может захватывать таблица
+    void resize(size_t slots)
+    {
+        owned.reset(new std::atomic<uint8_t>[slots]);
+        for (size_t i = 0; i < slots; ++i)
+        {
+            owned[i].store(0, std::memory_order_relaxed);
+        }
+        count = slots;
+    }
+
+    size_t size() const { return count; }
+
+    // Захват пары; false — один из NPC уже участвует в другом бою
+    bool tryClaim(EntityHandle a, EntityHandle b)
+    {
+        if (!claim(a))
+            return false;
+        if (a != b && !claim(b))
+        {
+            release(a);
+            return false;
+        }
+        return true;
+    }
+
+    void release(EntityHandle a, EntityHandle b)
+    {
+        release(a);
+        if (a != b)
+            release(b);
+    }
+};
@@ -3,19 +3,309 @@
 #include <mutex>
 #include <condition_variable>
 #include <memory>
+#include <atomic>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include "EntityStore.h"
+#include "Metrics.h"
 
-// Структура для задачи боя
+// Структура для задачи боя.
+// Участники — обычные указатели: копирование задачи не трогает атомарные
+// счётчики ссылок. Задача не владеет NPC — их держит хранилище мира,
+// пока задача не обработана.
 struct BattleTask
 {
-    std::shared_ptr<class NPC> attacker;
-    std::shared_ptr<class NPC> defender;
+    class NPC *attacker = nullptr;
+    class NPC *defender = nullptr;
+    // Дескрипторы участников в EntityStore (если задача создана из хранилища)
+    EntityHandle attackerHandle = INVALID_ENTITY;
+    EntityHandle defenderHandle = INVALID_ENTITY;
+    // Эпоха (номер тика), в которой обнаружена пара
+    uint64_t epoch = 0;
 
-    BattleTask(std::shared_ptr<class NPC> atk, std::shared_ptr<class NPC> def)
+    BattleTask(class NPC *atk, class NPC *def)
         : attacker(atk), defender(def) {}
+
+    BattleTask(class NPC *atk, class NPC *def,
+               EntityHandle atkHandle, EntityHandle defHandle, uint64_t epoch = 0)
+        : attacker(atk), defender(def), attackerHandle(atkHandle), defenderHandle(defHandle), epoch(epoch) {}
+
+    template <class T>
+    BattleTask(const std::shared_ptr<T> &atk, const std::shared_ptr<T> &def,
+               EntityHandle atkHandle = INVALID_ENTITY, EntityHandle defHandle = INVALID_ENTITY, uint64_t epoch = 0)
+        : BattleTask(atk.get(), def.get(), atkHandle, defHandle, epoch) {}
+};
+
+// Счётчики фильтрации задач при постановке в очередь
+struct BattleQueueStats
+{
+    uint64_t enqueued = 0;    // Задачи, попавшие в очередь
+    uint64_t coalesced = 0;   // Повторы пары, уже ожидающей в очереди
+    uint64_t droppedDead = 0; // Задачи с уже погибшим участником
+};
+
+// Множество пар NPC, ожидающих боя в очереди.
+// Ключ — упорядоченная пара дескрипторов, значение — эпоха поставленной задачи.
+// Пара снова может попасть в очередь только после того, как её задачу извлекли.
+// Разбито на сегменты со своими мьютексами, чтобы производители и потребители
+// разных пар не мешали друг другу.
+class PendingBattlePairs
+{
+private:
+    static constexpr size_t SHARDS = 16;
+
+    struct alignas(64) Shard
+    {
+        std::mutex mtx;
+        std::unordered_map<uint64_t, uint64_t> epochs;
+    };
+
+    Shard shards[SHARDS];
+
+    static uint64_t key(const BattleTask &task)
+    {
+        uint64_t a = std::min(task.attackerHandle, task.defenderHandle);
+        uint64_t b = std::max(task.attackerHandle, task.defenderHandle);
+        return (a << 32) | b;
+    }
+
+    Shard &shardOf(uint64_t k)
+    {
+        return shards[(k * 0x9E3779B97F4A7C15ull) >> 60];
+    }
+
+public:
+    static bool tracked(const BattleTask &task)
+    {
+        return task.attackerHandle != INVALID_ENTITY && task.defenderHandle != INVALID_ENTITY;
+    }
+
+    // false — пара уже ожидает в очереди
+    bool tryAdd(const BattleTask &task)
+    {
+        uint64_t k = key(task);
+        Shard &shard = shardOf(k);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        return shard.epochs.emplace(k, task.epoch).second;
+    }
+
+    // Снять пару после извлечения задачи. Запись удаляется только если
+    // её эпоха совпадает с эпохой задачи.
+    void remove(const BattleTask &task)
+    {
+        uint64_t k = key(task);
+        Shard &shard = shardOf(k);
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        auto it = shard.epochs.find(k);
+        if (it != shard.epochs.end() && it->second == task.epoch)
+        {
+            shard.epochs.erase(it);
+        }
+    }
+
+    size_t size()
+    {
+        size_t total = 0;
+        for (auto &shard : shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mtx);
+            total += shard.epochs.size();
+        }
+        return total;
+    }
+};
+
+// Общий интерфейс очередей задач для боев.
+// При постановке задачи отбрасываются, если кто-то из участников уже мёртв.
+// С объединением (coalesce) задача отбрасывается и тогда, когда такая же пара
+// ещё ждёт в очереди: если потоки боёв отстают от тиков, очередь не растёт от
+// повторов одних и тех же пар. Учёт ожидающих пар стоит мьютекса сегмента и
+// операции с хеш-таблицей на каждую задачу при постановке и извлечении,
+// поэтому его выключают, когда повторов быть не может.
+class BattleTaskQueue
+{
+private:
+    const bool coalesce;
+    PendingBattlePairs pending;
+    std::atomic<uint64_t> enqueuedCount{0};
+    std::atomic<uint64_t> coalescedCount{0};
+    std::atomic<uint64_t> droppedDeadCount{0};
+
+    // Метрики общие для всех очередей программы; обновляются раз на пакет
+    struct Metrics
+    {
+        Counter &enqueued;
+        Counter &coalesced;
+        Counter &droppedDead;
+        Counter &dequeued;
+        Gauge &depth;
+    };
+
+    static Metrics &metrics()
+    {
+        MetricsRegistry &registry = MetricsRegistry::global();
+        static Metrics m{
+            registry.counter("dungeon_battle_queue_enqueued_total", "Задачи боёв, принятые очередью"),
+            registry.counter("dungeon_battle_queue_coalesced_total", "Задачи боёв, объединённые с ожидающей парой"),
+            registry.counter("dungeon_battle_queue_dropped_dead_total", "Задачи боёв, отброшенные из-за погибшего участника"),
+            registry.counter("dungeon_battle_queue_dequeued_total", "Задачи боёв, извлечённые потоками боёв"),
+            registry.gauge("dungeon_battle_queue_depth", "Задачи боёв, ожидающие в очереди")};
+        return m;
+    }
+
+    // Проверка задачи перед постановкой в очередь
+    bool admit(const BattleTask &task, uint64_t &dead, uint64_t &coalesced)
+    {
+        if ((task.attacker && !task.attacker->isAlive()) ||
+            (task.defender && !task.defender->isAlive()))
+        {
+            ++dead;
+            return false;
+        }
+        if (coalesce && PendingBattlePairs::tracked(task) && !pending.tryAdd(task))
+        {
+            ++coalesced;
+            return false;
+        }
+        return true;
+    }
+
+    // Учёт задач, не прошедших admit
+    void countRejected(uint64_t dead, uint64_t coalesced)
+    {
+        Metrics &m = metrics();
+        if (dead > 0)
+        {
+            droppedDeadCount.fetch_add(dead, std::memory_order_relaxed);
+            m.droppedDead.add(dead);
+        }
+        if (coalesced > 0)
+        {
+            coalescedCount.fetch_add(coalesced, std::memory_order_relaxed);
+            m.coalesced.add(coalesced);
+        }
+    }
+
+    // Постановка admitted задач, прошедших admit; учитываются только принятые.
+    // Глубина увеличивается заранее: пакет может ждать места в очереди, пока
+    // потребители уже разбирают его начало
+    void enqueue(BattleTask *tasks, size_t admitted)
+    {
+        if (admitted == 0)
+            return;
+        Metrics &m = metrics();
+        m.depth.add((int64_t)admitted);
+        size_t accepted = pushBatch(tasks, admitted);
+        if (accepted < admitted)
+        {
+            // Непринятые задачи больше не ждут в очереди
+            m.depth.sub((int64_t)(admitted - accepted));
+            for (size_t i = accepted; i < admitted && coalesce; ++i)
+            {
+                if (PendingBattlePairs::tracked(tasks[i]))
+                    pending.remove(tasks[i]);
+            }
+        }
+        if (accepted > 0)
+        {
+            enqueuedCount.fetch_add(accepted, std::memory_order_relaxed);
+            m.enqueued.add(accepted);
+        }
+    }
+
+protected:
+    explicit BattleTaskQueue(bool coalesce) : coalesce(coalesce) {}
+
+    // Реализация хранения: задачи уже отфильтрованы, их можно перемещать.
+    // pushBatch возвращает число принятых задач: они перемещаются из начала
+    // массива, непринятые (очередь остановлена и заполнена) остаются на месте
+    virtual size_t pushBatch(BattleTask *tasks, size_t count) = 0;
+    virtual size_t popBatch(BattleTask *out, size_t maxCount) = 0;
+
+public:
+    virtual ~BattleTaskQueue() = default;
+
+    // Добавить задачу в очередь
+    void push(const BattleTask &task)
+    {
+        uint64_t dead = 0, coalesced = 0;
+        if (admit(task, dead, coalesced))
+        {
+            BattleTask copy = task;
+            enqueue(&copy, 1);
+        }
+        else
+        {
+            countRejected(dead, coalesced);
+        }
+    }
+
+    // Добавить несколько задач с одним пробуждением потребителей.
+    // Задачи перемещаются из массива.
+    void push_n(BattleTask *tasks, size_t count)
+    {
+        size_t admitted = 0;
+        uint64_t dead = 0, coalesced = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (admit(tasks[i], dead, coalesced))
+            {
+                if (admitted != i)
+                    tasks[admitted] = std::move(tasks[i]);
+                ++admitted;
+            }
+        }
+        countRejected(dead, coalesced);
+        enqueue(tasks, admitted);
+    }
+
+    // Извлечь задачу (блокирующая операция); false — очередь остановлена и пуста
+    bool pop(BattleTask &task)
+    {
+        return pop_n(&task, 1) == 1;
+    }
+
+    // Извлечь до maxCount задач (блокирующая операция); 0 — очередь остановлена и пуста
+    size_t pop_n(BattleTask *out, size_t maxCount)
+    {
+        size_t count = popBatch(out, maxCount);
+        for (size_t i = 0; i < count && coalesce; ++i)
+        {
+            if (PendingBattlePairs::tracked(out[i]))
+                pending.remove(out[i]);
+        }
+        if (count > 0)
+        {
+            Metrics &m = metrics();
+            m.dequeued.add(count);
+            m.depth.sub((int64_t)count);
+        }
+        return count;
+    }
+
+    // Остановить очередь: ожидающие потребители просыпаются,
+    // оставшиеся задачи по-прежнему можно извлечь
+    virtual void stop() = 0;
+
+    // Проверка, пуста ли очередь
+    virtual bool empty() = 0;
+
+    BattleQueueStats stats() const
+    {
+        BattleQueueStats s;
+        s.enqueued = enqueuedCount.load(std::memory_order_relaxed);
+        s.coalesced = coalescedCount.load(std::memory_order_relaxed);
+        s.droppedDead = droppedDeadCount.load(std::memory_order_relaxed);
+        return s;
+    }
+
+    // Число пар, ожидающих в очереди
+    size_t pendingPairs() { return pending.size(); }
 };
 
 // Потокобезопасная очередь задач для боев
-class BattleQueue
+class BattleQueue : public BattleTaskQueue
 {
 private:
     std::queue<BattleTask> tasks;
@@ -24,33 +314,42 @@ private:
     bool stopped = false;
 
 public:
-    // Добавить задачу в очередь
-    void push(const BattleTask &task)
+    explicit BattleQueue(bool coalesce = true) : BattleTaskQueue(coalesce) {}
+
+protected:
+    size_t pushBatch(BattleTask *batch, size_t count) override
     {
         std::lock_guard<std::mutex> lock(mtx);
-        tasks.push(task);
-        cv.notify_one();
+        for (size_t i = 0; i < count; ++i)
+        {
+            tasks.push(std::move(batch[i]));
+        }
+        if (count == 1)
+            cv.notify_one();
+        else
+            cv.notify_all();
+        return count;
     }
 
-    // Извлечь задачу из очереди (блокирующая операция)
-    bool pop(BattleTask &task)
+    // Извлечь задачи из очереди (блокирующая операция)
+    size_t popBatch(BattleTask *out, size_t maxCount) override
     {
         std::unique_lock<std::mutex> lock(mtx);
         cv.wait(lock, [this]
                 { return !tasks.empty() || stopped; });
 
-        if (stopped && tasks.empty())
+        size_t count = 0;
+        while (count < maxCount && !tasks.empty())
         {
-            return false;
+            out[count++] = std::move(tasks.front());
+            tasks.pop();
         }
-
-        task = tasks.front();
-        tasks.pop();
-        return true;
+        return count;
     }
 
+public:
     // Остановить очередь
-    void stop()
+    void stop() override
     {
         std::lock_guard<std::mutex> lock(mtx);
         stopped = true;
@@ -58,7 +357,7 @@ public:
     }
 
     // Проверка, пуста ли очередь
-    bool empty()
+    bool empty() override
     {
         std::lock_guard<std::mutex> lock(mtx);
         return tasks.empty();
@@ -0,0 +1,88 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include "BattleQueue.h"
+#include "EntityStore.h"
+#include "CounterRng.h"
+
+// Порядок боёв тика, не зависящий от числа потоков боёв.
+// Задачи сортируются по (эпоха, перемешанный ключ пары) и раскладываются по раундам:
+// задача идёт в раунд сразу за последним раундом, где уже был кто-то из её
+// участников. В одном раунде у задач нет общих NPC — их можно разбирать
+// параллельно в любом порядке, а раунды разбираются строго друг за другом.
+// Бои каждого NPC идут в порядке сортировки, исход боя зависит только от
+// участников и ключа (CounterRng), поэтому итог совпадает с разбором всех
+// задач по порядку в одном потоке. Ключ перемешивается (CounterRng::mix):
+// при порядке по дескрипторам бои одного NPC тянут длинные цепочки раундов.
+// Участники задаются дескрипторами; ячейка таблицы — слот (EntityStore::slotOf).
+class BattleRounds
+{
+private:
+    std::vector<BattleTask> ordered;
+    // starts[r] — начало раунда r в ordered; последний элемент — конец
+    std::vector<size_t> starts;
+    // Для слота: номер раунда после последнего боя NPC (0 — боёв ещё не было)
+    std::vector<uint32_t> nextRound;
+    std::vector<uint32_t> roundOf;
+
+public:
+    // Порядок задачи внутри эпохи
+    static uint64_t orderKey(const BattleTask &task)
+    {
+        return CounterRng::mix(((uint64_t)task.attackerHandle << 32) | task.defenderHandle);
+    }
+
+    // Упорядочить задачи и разбить на раунды; задачи перемещаются из tasks,
+    // tasks остаётся пустым
+    void plan(std::vector<BattleTask> &tasks)
+    {
+        std::sort(tasks.begin(), tasks.end(), [](const BattleTask &a, const BattleTask &b)
+                  { return a.epoch != b.epoch ? a.epoch < b.epoch : orderKey(a) < orderKey(b); });
+
+        size_t slots = nextRound.size();
+        for (const auto &task : tasks)
+            slots = std::max<size_t>({slots, EntityStore::slotOf(task.attackerHandle) + 1,
+                              EntityStore::slotOf(task.defenderHandle) + 1});
+        nextRound.resize(slots, 0);
+
+        roundOf.resize(tasks.size());
+        uint32_t rounds = 0;
+        for (size_t i = 0; i < tasks.size(); ++i)
+        {
+            uint32_t &attacker = nextRound[EntityStore::slotOf(tasks[i].attackerHandle)];
+            uint32_t &defender = nextRound[EntityStore::slotOf(tasks[i].defenderHandle)];
+            uint32_t round = std::max(attacker, defender);
+            attacker = defender = round + 1;
+            roundOf[i] = round;
+            rounds = std::max(rounds, round + 1);
+        }
+
+        // Раскладка по раундам с сохранением порядка внутри раунда
+        starts.assign(rounds + 1, 0);
+        for (size_t i = 0; i < tasks.size(); ++i)
+            ++starts[roundOf[i] + 1];
+        for (size_t r = 1; r <= rounds; ++r)
+            starts[r] += starts[r - 1];
+
+        ordered.assign(tasks.size(), BattleTask(nullptr, nullptr));
+        std::vector<size_t> fill(starts.begin(), starts.end() - 1);
+        for (size_t i = 0; i < tasks.size(); ++i)
+        {
+            // Таблица раундов обнуляется только по затронутым слотам
+            nextRound[EntityStore::slotOf(tasks[i].attackerHandle)] = 0;
+            nextRound[EntityStore::slotOf(tasks[i].defenderHandle)] = 0;
+            ordered[fill[roundOf[i]]++] = std::move(tasks[i]);
+        }
+        tasks.clear();
+    }
+
+    size_t rounds() const { return starts.empty() ? 0 : starts.size() - 1; }
+
+    // Задачи раунда r; их можно перемещать
+    BattleTask *round(size_t r) { return ordered.data() + starts[r]; }
+    size_t roundSize(size_t r) const { return starts[r + 1] - starts[r]; }
+
+    size_t size() const { return ordered.size(); }
+};
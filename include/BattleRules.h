@@ -0,0 +1,45 @@
+#pragma once
+#include "NPC.h"
+
+// Правила боя в виде таблицы, построенной на этапе компиляции.
+// CAN_KILL[a][b] — может ли NPC типа a убить NPC типа b (индексы — NPCType).
+constexpr bool CAN_KILL[NPC_TYPE_COUNT][NPC_TYPE_COUNT] = {
+    //            Knight Druid  Elf
+    /* Knight */ {false, false, true},
+    /* Druid  */ {false, true, false},
+    /* Elf    */ {true, true, false},
+};
+
+// Исход встречи атакующего и защищающегося
+struct KillRule
+{
+    bool attackerCanKill;
+    bool defenderCanKill;
+};
+
+constexpr KillRule makeKillRule(int attacker, int defender)
+{
+    return KillRule{CAN_KILL[attacker][defender], CAN_KILL[defender][attacker]};
+}
+
+// Матрица 3x3: KILL_RULES[атакующий][защищающийся]
+constexpr KillRule KILL_RULES[NPC_TYPE_COUNT][NPC_TYPE_COUNT] = {
+    {makeKillRule(0, 0), makeKillRule(0, 1), makeKillRule(0, 2)},
+    {makeKillRule(1, 0), makeKillRule(1, 1), makeKillRule(1, 2)},
+    {makeKillRule(2, 0), makeKillRule(2, 1), makeKillRule(2, 2)},
+};
+
+constexpr KillRule killRule(NPCType attacker, NPCType defender)
+{
+    return KILL_RULES[(int)attacker][(int)defender];
+}
+
+static_assert(killRule(NPCType::Knight, NPCType::Elf).attackerCanKill &&
+                  killRule(NPCType::Knight, NPCType::Elf).defenderCanKill,
+              "Рыцарь и эльф убивают друг друга");
+static_assert(killRule(NPCType::Elf, NPCType::Druid).attackerCanKill &&
+                  !killRule(NPCType::Elf, NPCType::Druid).defenderCanKill,
+              "Эльф убивает друида, друид эльфа — нет");
+static_assert(!killRule(NPCType::Knight, NPCType::Druid).attackerCanKill &&
+                  !killRule(NPCType::Knight, NPCType::Druid).defenderCanKill,
+              "Рыцарь и друид не сражаются");
@@ -4,36 +4,47 @@
 #include "Druid.h"
 #include "Elf.h"
 #include "Observer.h"
+#include "BattleRules.h"
+#include "CounterRng.h"
 #include <functional>
 #include <random>
 #include <mutex>
+#include <cstdint>
 
 // Реализация Visitor для боевой системы с бросками кубика
-// Правила боя:
+// Правила боя (таблица KILL_RULES в BattleRules.h):
 // - Рыцарь убивает эльфа
 // - Эльф убивает друида и рыцаря
 // - Друид убивает друидов
 // - В бою каждый NPC бросает 6-гранный кубик
 // - Если атака > защита, происходит убийство
+//
+// Броски берутся из CounterRng по ключу (seed, тик, пара, номер боя, номер броска),
+// поэтому генератор не требует блокировок, а бой с тем же seed и контекстом
+// (setBattleContext) даёт те же броски в любом потоке.
 
 class BattleVisitor : public Visitor
 {
 private:
     Subject &subject;
     std::function<int()> rollFn;
-    mutable std::mutex rng_mutex; // Мьютекс для генератора случайных чисел
-    mutable std::mt19937 rng;
-    mutable std::uniform_int_distribution<int> dice;
+    mutable std::mutex rollFn_mutex; // Только для тестового rollFn: его состояние может быть общим
+    uint64_t seed;
 
-    // Бросок кубика (1-6)
-    int rollDice() const
+    // Контекст текущего боя: тик, пара и номер боя внутри контекста
+    uint64_t battleTick = 0;
+    uint64_t battlePair = 0;
+    uint64_t battleIndex = 0;
+
+    // Бросок кубика (1-6); roll — номер броска в бою
+    int rollDice(uint64_t roll) const
     {
-        std::lock_guard<std::mutex> lock(rng_mutex);
         if (rollFn)
         {
+            std::lock_guard<std::mutex> lock(rollFn_mutex);
             return rollFn();
         }
-        return dice(rng);
+        return CounterRng::dice(seed, battleTick, battlePair, (battleIndex << 1) | roll);
     }
 
     void fight(NPC &attacker, NPC &defender, bool canAttackerKill, bool canDefenderKill)
@@ -44,112 +55,84 @@ private:
             return;
         }
 
-        int attackRoll = rollDice();
-        int defenseRoll = rollDice();
+        int attackRoll = rollDice(0);
+        int defenseRoll = rollDice(1);
+        ++battleIndex;
 
-        if (canAttackerKill && canDefenderKill)
-        {
-            // Оба могут убивать друг друга
-            if (attackRoll > defenseRoll)
-            {
-                // Атакующий побеждает
-                defender.kill();
-                subject.notify(attacker.getName() + " (" + attacker.getType() + ")",
-                               defender.getName() + " (" + defender.getType() + ") [Атака:" + std::to_string(attackRoll) + " > Защита:" + std::to_string(defenseRoll) + "]");
-            }
-            else if (defenseRoll > attackRoll)
-            {
-                // Защищающийся побеждает
-                attacker.kill();
-                subject.notify(defender.getName() + " (" + defender.getType() + ")",
-                               attacker.getName() + " (" + attacker.getType() + ") [Защита:" + std::to_string(defenseRoll) + " > Атака:" + std::to_string(attackRoll) + "]");
-            }
-            // Если равны - ничья
-        }
-        else if (canAttackerKill)
+        // Исход: побеждает атакующий, если он может убить и бросил больше;
+        // защищающийся — если может убить и бросил больше; иначе ничья
+        if (canAttackerKill && attackRoll > defenseRoll)
         {
-            // Только атакующий может убить
-            if (attackRoll > defenseRoll)
-            {
-                defender.kill();
-                subject.notify(attacker.getName() + " (" + attacker.getType() + ")",
-                               defender.getName() + " (" + defender.getType() + ") [Атака:" + std::to_string(attackRoll) + " > Защита:" + std::to_string(defenseRoll) + "]");
-            }
+            defender.kill();
+            report(attacker, defender, attackRoll, defenseRoll, false);
         }
-        else if (canDefenderKill)
+        else if (canDefenderKill && defenseRoll > attackRoll)
         {
-            // Только защищающийся может убить
-            if (defenseRoll > attackRoll)
-            {
-                attacker.kill();
-                subject.notify(defender.getName() + " (" + defender.getType() + ")",
-                               attacker.getName() + " (" + attacker.getType() + ") [Защита:" + std::to_string(defenseRoll) + " > Атака:" + std::to_string(attackRoll) + "]");
-            }
+            attacker.kill();
+            report(defender, attacker, attackRoll, defenseRoll, true);
         }
     }
 
+    // Событие убийства без сборки строк: текст формируют наблюдатели
+    void report(const NPC &killer, const NPC &victim, int attackRoll, int defenseRoll, bool byDefender)
+    {
+        KillEvent event{killer.getId(), victim.getId(), killer.getNameId(), victim.getNameId(),
+                        killer.getTypeTag(), victim.getTypeTag(),
+                        (uint8_t)attackRoll, (uint8_t)defenseRoll, byDefender, battleTick};
+        subject.notify(event);
+    }
+
 public:
     BattleVisitor(Subject &subject)
-        : subject(subject), rng(std::random_device{}()), dice(1, 6) {}
+        : subject(subject), seed(randomSeed()) {}
+
+    // Воспроизводимые бои: одинаковый seed и контекст дают одинаковые броски
+    BattleVisitor(Subject &subject, uint64_t seed)
+        : subject(subject), seed(seed) {}
 
     // Конструктор для тестов: позволяет задать детерминированный бросок кубика
     BattleVisitor(Subject &subject, std::function<int()> rollFn)
-        : subject(subject), rollFn(std::move(rollFn)), rng(std::random_device{}()), dice(1, 6) {}
-
-    // Knight vs ...
-    void visitKnight(Knight &attacker, Knight &defender) override
-    {
-        // Рыцарь не убивает рыцаря
-        fight(attacker, defender, false, false);
-    }
+        : subject(subject), rollFn(std::move(rollFn)), seed(randomSeed()) {}
 
-    void visitKnight(Knight &attacker, Druid &defender) override
+    static uint64_t randomSeed()
     {
-        // Рыцарь не убивает друида
-        fight(attacker, defender, false, false);
+        std::random_device rd;
+        return ((uint64_t)rd() << 32) | rd();
     }
 
-    void visitKnight(Knight &attacker, Elf &defender) override
+    // Ключ пары для контекста боя
+    static uint64_t pairKey(uint32_t attacker, uint32_t defender)
     {
-        // Рыцарь убивает эльфа, но эльф тоже убивает рыцаря
-        fight(attacker, defender, true, true);
+        return ((uint64_t)attacker << 32) | defender;
     }
 
-    // Druid vs ...
-    void visitDruid(Druid &attacker, Knight &defender) override
+    // Задать контекст следующих боёв (тик и пара); номер боя сбрасывается
+    void setBattleContext(uint64_t tick, uint64_t pair)
     {
-        // Друид не убивает рыцаря
-        fight(attacker, defender, false, false);
+        battleTick = tick;
+        battlePair = pair;
+        battleIndex = 0;
     }
 
-    void visitDruid(Druid &attacker, Druid &defender) override
-    {
-        // Друид убивает друида
-        fight(attacker, defender, true, true);
-    }
+    uint64_t getSeed() const { return seed; }
 
-    void visitDruid(Druid &attacker, Elf &defender) override
+    // Бой по таблице правил: один поиск в матрице KILL_RULES
+    void visit(NPC &attacker, NPC &defender) override
     {
-        // Друид не убивает эльфа, но эльф убивает друида
-        fight(attacker, defender, false, true);
+        KillRule rule = killRule(attacker.getTypeTag(), defender.getTypeTag());
+        fight(attacker, defender, rule.attackerCanKill, rule.defenderCanKill);
     }
 
-    // Elf vs ...
-    void visitElf(Elf &attacker, Knight &defender) override
-    {
-        // Эльф убивает рыцаря, но рыцарь тоже убивает эльфа
-        fight(attacker, defender, true, true);
-    }
+    // Типизированные перегрузки Visitor сводятся к той же таблице
+    void visitKnight(Knight &attacker, Knight &defender) override { visit(attacker, defender); }
+    void visitKnight(Knight &attacker, Druid &defender) override { visit(attacker, defender); }
+    void visitKnight(Knight &attacker, Elf &defender) override { visit(attacker, defender); }
 
-    void visitElf(Elf &attacker, Druid &defender) override
-    {
-        // Эльф убивает друида
-        fight(attacker, defender, true, false);
-    }
+    void visitDruid(Druid &attacker, Knight &defender) override { visit(attacker, defender); }
+    void visitDruid(Druid &attacker, Druid &defender) override { visit(attacker, defender); }
+    void visitDruid(Druid &attacker, Elf &defender) override { visit(attacker, defender); }
 
-    void visitElf(Elf &attacker, Elf &defender) override
-    {
-        // Эльф не убивает эльфа
-        fight(attacker, defender, false, false);
-    }
+    void visitElf(Elf &attacker, Knight &defender) override { visit(attacker, defender); }
+    void visitElf(Elf &attacker, Druid &defender) override { visit(attacker, defender); }
+    void visitElf(Elf &attacker, Elf &defender) override { visit(attacker, defender); }
 };
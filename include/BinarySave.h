@@ -0,0 +1,248 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "NPC.h"
+#include "EntityStore.h"
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Двоичный формат сохранения редактора (little-endian):
+//   заголовок Header (32 байта);
+//   count записей Record фиксированного размера (24 байта);
+//   таблица строк: имена подряд, без разделителей.
+// Файл отображается в память целиком; записи читаются на месте, без разбора текста.
+// Числовые поля при записи и чтении приводятся к little-endian (на little-endian
+// машинах это пустая операция), поэтому файл переносим между платформами.
+// Старые версии формата отклоняются по полю version.
+class BinarySave
+{
+public:
+    static constexpr uint32_t MAGIC = 0x4350'4E44; // "DNPC"
+    static constexpr uint16_t VERSION = 1;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t recordSize;
+        uint64_t count;
+        uint64_t stringTableOffset;
+        uint64_t stringTableSize;
+    };
+
+    struct Record
+    {
+        double x, y;
+        uint32_t nameOffset; // Смещение имени в таблице строк
+        uint16_t nameLength;
+        uint8_t type;        // NPCType
+        uint8_t reserved;
+    };
+
+    static_assert(sizeof(Header) == 32, "Заголовок двоичного сохранения должен занимать 32 байта");
+    static_assert(sizeof(Record) == 24, "Запись двоичного сохранения должна занимать 24 байта");
+
+private:
+    static bool hostIsLittleEndian()
+    {
+        const uint16_t one = 1;
+        unsigned char first;
+        std::memcpy(&first, &one, 1);
+        return first == 1;
+    }
+
+    // Значение в порядке байтов файла; то же преобразование переводит обратно
+    template <class T>
+    static T little(T value)
+    {
+        if (hostIsLittleEndian())
+            return value;
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        std::reverse(bytes, bytes + sizeof(T));
+        std::memcpy(&value, bytes, sizeof(T));
+        return value;
+    }
+
+    static void swapToFileOrder(Header &header)
+    {
+        header.magic = little(header.magic);
+        header.version = little(header.version);
+        header.recordSize = little(header.recordSize);
+        header.count = little(header.count);
+        header.stringTableOffset = little(header.stringTableOffset);
+        header.stringTableSize = little(header.stringTableSize);
+    }
+
+    static void swapToFileOrder(Record &record)
+    {
+        record.x = little(record.x);
+        record.y = little(record.y);
+        record.nameOffset = little(record.nameOffset);
+        record.nameLength = little(record.nameLength);
+    }
+
+public:
+
+    // Начинается ли содержимое с сигнатуры двоичного формата
+    static bool isBinary(const char *data, size_t size)
+    {
+        uint32_t magic = 0;
+        if (size < sizeof(magic))
+            return false;
+        std::memcpy(&magic, data, sizeof(magic));
+        return little(magic) == MAGIC;
+    }
+
+    // Сохранение живых NPC хранилища
+    static bool write(const std::string &filename, const EntityStore &store)
+    {
+        std::vector<Record> records;
+        std::string strings;
+        records.reserve(store.size());
+        for (size_t row = 0; row < store.size(); ++row)
+        {
+            if (!store.isAlive(row))
+                continue;
+            const std::string &name = NameTable::global().name(store.nameId(row));
+            if (name.size() > UINT16_MAX || strings.size() + name.size() > UINT32_MAX)
+                return false;
+
+            Record record{};
+            record.x = store.x(row);
+            record.y = store.y(row);
+            record.nameOffset = (uint32_t)strings.size();
+            record.nameLength = (uint16_t)name.size();
+            record.type = (uint8_t)store.type(row);
+            swapToFileOrder(record);
+            records.push_back(record);
+            strings += name;
+        }
+
+        Header header{};
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.recordSize = sizeof(Record);
+        header.count = records.size();
+        header.stringTableOffset = sizeof(Header) + records.size() * sizeof(Record);
+        header.stringTableSize = strings.size();
+        swapToFileOrder(header);
+
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return false;
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(records.data()), (std::streamsize)(records.size() * sizeof(Record)));
+        file.write(strings.data(), (std::streamsize)strings.size());
+        return (bool)file;
+    }
+
+    // Проверка заголовка и границ; f(type, name, x, y) вызывается для каждой записи.
+    // Возвращает false для повреждённых данных или неизвестной версии.
+    template <class F>
+    static bool read(const char *data, size_t size, F &&f)
+    {
+        if (size < sizeof(Header) || !isBinary(data, size))
+            return false;
+
+        Header header;
+        std::memcpy(&header, data, sizeof(header));
+        swapToFileOrder(header);
+        if (header.version != VERSION || header.recordSize != sizeof(Record))
+            return false;
+        if (header.count > (size - sizeof(Header)) / sizeof(Record) ||
+            header.stringTableOffset != sizeof(Header) + header.count * sizeof(Record) ||
+            header.stringTableSize > size - header.stringTableOffset)
+            return false;
+
+        const char *strings = data + header.stringTableOffset;
+        for (uint64_t i = 0; i < header.count; ++i)
+        {
+            Record record;
+            std::memcpy(&record, data + sizeof(Header) + i * sizeof(Record), sizeof(record));
+            swapToFileOrder(record);
+            if (record.type >= NPC_TYPE_COUNT ||
+                (uint64_t)record.nameOffset + record.nameLength > header.stringTableSize)
+                return false;
+            f((NPCType)record.type, std::string(strings + record.nameOffset, record.nameLength), record.x, record.y);
+        }
+        return true;
+    }
+};
+
+// Файл, отображённый в память только для чтения.
+// Без mmap (Windows) содержимое читается в буфер целиком.
+class MappedFile
+{
+private:
+    const char *mapped = nullptr;
+    size_t length = 0;
+    bool opened = false;
+#ifdef _WIN32
+    std::vector<char> buffer;
+#endif
+
+public:
+    explicit MappedFile(const std::string &filename)
+    {
+#ifdef _WIN32
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open())
+            return;
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        opened = true;
+        mapped = buffer.data();
+        length = buffer.size();
+#else
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat st;
+        if (::fstat(fd, &st) == 0)
+        {
+            opened = true;
+            if (st.st_size > 0)
+            {
+                void *p = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED)
+                {
+                    mapped = static_cast<const char *>(p);
+                    length = (size_t)st.st_size;
+                }
+                else
+                {
+                    opened = false;
+                }
+            }
+        }
+        ::close(fd);
+#endif
+    }
+
+    ~MappedFile()
+    {
+#ifndef _WIN32
+        if (mapped && length > 0)
+            ::munmap(const_cast<char *>(mapped), length);
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool isOpen() const { return opened; }
+    const char *data() const { return mapped; }
+    size_t size() const { return length; }
+};
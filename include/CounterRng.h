@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+
+// Генератор случайных чисел на счётчике (SplitMix64).
+// Значение — чистая функция от (seed, ключи), поэтому у генератора нет
+// состояния: любое число потоков получает числа без блокировок, а запуск
+// с тем же seed воспроизводит те же значения независимо от порядка вызовов.
+class CounterRng
+{
+public:
+    // Финализатор SplitMix64: биективное перемешивание 64-битного слова
+    static constexpr uint64_t mix(uint64_t z)
+    {
+        z += 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // 64 случайных бита для набора ключей
+    static constexpr uint64_t bits(uint64_t seed, uint64_t a, uint64_t b = 0, uint64_t c = 0)
+    {
+        return mix(mix(mix(mix(seed) ^ a) ^ b) ^ c);
+    }
+
+    // Равномерное число в [0, 1)
+    static constexpr double uniform(uint64_t seed, uint64_t a, uint64_t b = 0, uint64_t c = 0)
+    {
+        return (double)(bits(seed, a, b, c) >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // Равномерное целое в [0, n)
+    static constexpr uint32_t below(uint32_t n, uint64_t seed, uint64_t a, uint64_t b = 0, uint64_t c = 0)
+    {
+        return (uint32_t)(((bits(seed, a, b, c) >> 32) * n) >> 32);
+    }
+
+    // Бросок 6-гранного кубика
+    static constexpr int dice(uint64_t seed, uint64_t a, uint64_t b = 0, uint64_t c = 0)
+    {
+        return 1 + (int)below(6, seed, a, b, c);
+    }
+};
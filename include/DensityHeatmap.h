@@ -0,0 +1,185 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "NPC.h"
+#include "WorldSnapshot.h"
+#include "TerminalRenderer.h"
+#include "ParallelFor.h"
+
+// Карта плотности NPC: число живых NPC каждого типа в клетках сетки
+// cols x rows, покрывающей карту width x height. Стоимость вывода зависит
+// только от размера сетки, а не от числа NPC.
+// build() раскладывает позиции снимка параллельно: у каждого потока своя
+// частичная гистограмма, затем гистограммы складываются по клеткам.
+class DensityHeatmap
+{
+private:
+    int cols, rows;
+    double width, height;
+    std::vector<uint32_t> counts; // [тип][строка][столбец]
+    uint32_t maxTotal = 0;
+    size_t totals[NPC_TYPE_COUNT] = {};
+
+    // Меньшие снимки быстрее разложить в одном потоке
+    static constexpr size_t MIN_PER_THREAD = 65536;
+
+    size_t cells() const { return (size_t)cols * rows; }
+
+    size_t cellOf(double x, double y) const
+    {
+        int col = std::min(cols - 1, std::max(0, (int)(x * cols / width)));
+        int row = std::min(rows - 1, std::max(0, (int)(y * rows / height)));
+        return (size_t)row * cols + col;
+    }
+
+    static bool writeHeader(std::ofstream &file, const char *magic, int cols, int rows)
+    {
+        file << magic << "\n"
+             << cols << " " << rows << "\n255\n";
+        return (bool)file;
+    }
+
+    // Яркость 0..255: корень от доли максимума, чтобы редкие клетки были заметны
+    static uint8_t level(uint32_t value, uint32_t max)
+    {
+        if (max == 0 || value == 0)
+            return 0;
+        return (uint8_t)std::lround(255.0 * std::sqrt((double)value / max));
+    }
+
+public:
+    // Символы заливки клетки терминала от пустой к самой плотной
+    static constexpr const char *SHADES = " .:-=+*#%@";
+    static constexpr int SHADE_COUNT = 10;
+
+    DensityHeatmap(int cols, int rows, double width, double height)
+        : cols(std::max(1, cols)), rows(std::max(1, rows)), width(width), height(height),
+          counts((size_t)NPC_TYPE_COUNT * this->cols * this->rows, 0) {}
+
+    int columns() const { return cols; }
+    int lines() const { return rows; }
+
+    // Подсчёт живых NPC снимка по клеткам; threads = 0 — по числу ядер
+    void build(const WorldSnapshot &snapshot, unsigned threads = 0)
+    {
+        const size_t n = snapshot.size();
+        threads = parallelThreads(n, threads, MIN_PER_THREAD);
+        const size_t histogram = counts.size();
+
+        // Частичные гистограммы потоков; первая — сам результат
+        std::fill(counts.begin(), counts.end(), 0);
+        std::vector<std::vector<uint32_t>> partials(threads > 1 ? threads - 1 : 0);
+        parallelFor(n, threads, [&](unsigned t, size_t begin, size_t end)
+                    {
+                        uint32_t *local = counts.data();
+                        if (t > 0)
+                        {
+                            partials[t - 1].assign(histogram, 0);
+                            local = partials[t - 1].data();
+                        }
+                        for (size_t i = begin; i < end; ++i)
+                        {
+                            if (snapshot.alives[i])
+                                ++local[(size_t)snapshot.types[i] * cells() + cellOf(snapshot.xs[i], snapshot.ys[i])];
+                        } });
+
+        // Сложение по клеткам тоже делится между потоками
+        parallelFor(histogram, partials.empty() ? 1 : threads, [&](unsigned, size_t begin, size_t end)
+                    {
+                        for (const auto &partial : partials)
+                            for (size_t k = begin; k < end; ++k)
+                                counts[k] += partial[k]; });
+
+        maxTotal = 0;
+        std::fill(std::begin(totals), std::end(totals), 0);
+        for (size_t cell = 0; cell < cells(); ++cell)
+        {
+            uint32_t sum = 0;
+            for (int type = 0; type < NPC_TYPE_COUNT; ++type)
+            {
+                sum += counts[(size_t)type * cells() + cell];
+                totals[type] += counts[(size_t)type * cells() + cell];
+            }
+            maxTotal = std::max(maxTotal, sum);
+        }
+    }
+
+    uint32_t count(NPCType type, int row, int col) const
+    {
+        return counts[(size_t)type * cells() + (size_t)row * cols + col];
+    }
+
+    uint32_t total(int row, int col) const
+    {
+        uint32_t sum = 0;
+        for (int type = 0; type < NPC_TYPE_COUNT; ++type)
+            sum += count((NPCType)type, row, col);
+        return sum;
+    }
+
+    uint32_t maxCellTotal() const { return maxTotal; }
+    size_t typeTotal(NPCType type) const { return totals[(int)type]; }
+
+    // Символ заливки клетки по общей плотности; непустая клетка не бывает пробелом
+    char shade(int row, int col) const
+    {
+        uint32_t value = total(row, col);
+        if (value == 0)
+            return SHADES[0];
+        return SHADES[1 + (int)std::lround(std::sqrt((double)value / maxTotal) * (SHADE_COUNT - 2))];
+    }
+
+    // Заливка в холст терминала, левый верхний угол — (top, left)
+    void draw(TerminalRenderer &canvas, int top, int left) const
+    {
+        for (int row = 0; row < rows; ++row)
+            for (int col = 0; col < cols; ++col)
+                canvas.put(top + row, left + col, (char32_t)shade(row, col));
+    }
+
+    // PGM (P5): яркость — общая плотность
+    bool writePGM(const std::string &filename) const
+    {
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        if (!file.is_open() || !writeHeader(file, "P5", cols, rows))
+            return false;
+        std::vector<uint8_t> pixels(cells());
+        for (int row = 0; row < rows; ++row)
+            for (int col = 0; col < cols; ++col)
+                pixels[(size_t)row * cols + col] = level(total(row, col), maxTotal);
+        file.write(reinterpret_cast<const char *>(pixels.data()), (std::streamsize)pixels.size());
+        return (bool)file;
+    }
+
+    // PPM (P6): каналы R, G, B — плотность рыцарей, друидов и эльфов
+    bool writePPM(const std::string &filename) const
+    {
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        if (!file.is_open() || !writeHeader(file, "P6", cols, rows))
+            return false;
+        std::vector<uint8_t> pixels(cells() * 3);
+        for (int row = 0; row < rows; ++row)
+        {
+            for (int col = 0; col < cols; ++col)
+            {
+                for (int type = 0; type < NPC_TYPE_COUNT; ++type)
+                    pixels[((size_t)row * cols + col) * 3 + type] = level(count((NPCType)type, row, col), maxTotal);
+            }
+        }
+        file.write(reinterpret_cast<const char *>(pixels.data()), (std::streamsize)pixels.size());
+        return (bool)file;
+    }
+
+    // Запись по расширению имени: .pgm — оттенки серого, иначе PPM по типам
+    bool write(const std::string &filename) const
+    {
+        const std::string pgm = ".pgm";
+        if (filename.size() >= pgm.size() && filename.compare(filename.size() - pgm.size(), pgm.size(), pgm) == 0)
+            return writePGM(filename);
+        return writePPM(filename);
+    }
+};
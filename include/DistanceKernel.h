@@ -0,0 +1,205 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define DISTANCE_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+// Пакетная проверка расстояний: одна точка против блока точек-кандидатов.
+// Результат — битовая маска (бит k установлен, если кандидат k в радиусе).
+// Сравниваются квадраты расстояний, без sqrt.
+// Реализация (AVX2, SSE2 или скалярная) выбирается один раз во время выполнения.
+class DistanceKernel
+{
+public:
+    // Максимальный размер блока за один вызов (по числу бит в маске)
+    static constexpr size_t BLOCK = 64;
+
+    enum class Path
+    {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    // Лучшая реализация, доступная на текущем процессоре
+    static Path bestPath()
+    {
+        static const Path path = detectPath();
+        return path;
+    }
+
+    static bool isSupported(Path path)
+    {
+        switch (path)
+        {
+        case Path::Scalar:
+            return true;
+#ifdef DISTANCE_KERNEL_X86
+        case Path::SSE2:
+            return __builtin_cpu_supports("sse2");
+        case Path::AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+        }
+    }
+
+    // Кандидаты xs[k], ys[k] (k < n <= BLOCK) на расстоянии не больше radius от (px, py)
+    static uint64_t withinRadiusMask(double px, double py, const double *xs, const double *ys,
+                                     size_t n, double radius)
+    {
+        return withinRadiusMask(bestPath(), px, py, xs, ys, n, radius);
+    }
+
+    static uint64_t withinRadiusMask(Path path, double px, double py, const double *xs, const double *ys,
+                                     size_t n, double radius)
+    {
+        switch (path)
+        {
+#ifdef DISTANCE_KERNEL_X86
+        case Path::AVX2:
+            return maskAVX2(px, py, xs, ys, nullptr, n, radius);
+        case Path::SSE2:
+            return maskSSE2(px, py, xs, ys, nullptr, n, radius);
+#endif
+        default:
+            return maskScalar(px, py, xs, ys, nullptr, n, radius);
+        }
+    }
+
+    // То же, но радиус пары — max(radius, radii[k]): так проверяется дальность
+    // убийства, когда у участников она разная
+    static uint64_t withinRangesMask(double px, double py, double radius, const double *xs, const double *ys,
+                                     const double *radii, size_t n)
+    {
+        return withinRangesMask(bestPath(), px, py, radius, xs, ys, radii, n);
+    }
+
+    static uint64_t withinRangesMask(Path path, double px, double py, double radius, const double *xs,
+                                     const double *ys, const double *radii, size_t n)
+    {
+        switch (path)
+        {
+#ifdef DISTANCE_KERNEL_X86
+        case Path::AVX2:
+            return maskAVX2(px, py, xs, ys, radii, n, radius);
+        case Path::SSE2:
+            return maskSSE2(px, py, xs, ys, radii, n, radius);
+#endif
+        default:
+            return maskScalar(px, py, xs, ys, radii, n, radius);
+        }
+    }
+
+    // Вызов f(k) для каждого кандидата в радиусе; n не ограничено
+    template <class F>
+    static void forEachWithin(double px, double py, const double *xs, const double *ys,
+                              size_t n, double radius, F &&f)
+    {
+        for (size_t base = 0; base < n; base += BLOCK)
+        {
+            size_t count = n - base < BLOCK ? n - base : BLOCK;
+            uint64_t mask = withinRadiusMask(px, py, xs + base, ys + base, count, radius);
+            forEachBit(mask, base, f);
+        }
+    }
+
+    template <class F>
+    static void forEachWithinRanges(double px, double py, double radius, const double *xs, const double *ys,
+                                    const double *radii, size_t n, F &&f)
+    {
+        for (size_t base = 0; base < n; base += BLOCK)
+        {
+            size_t count = n - base < BLOCK ? n - base : BLOCK;
+            uint64_t mask = withinRangesMask(px, py, radius, xs + base, ys + base, radii + base, count);
+            forEachBit(mask, base, f);
+        }
+    }
+
+private:
+    static Path detectPath()
+    {
+        if (isSupported(Path::AVX2))
+            return Path::AVX2;
+        if (isSupported(Path::SSE2))
+            return Path::SSE2;
+        return Path::Scalar;
+    }
+
+    template <class F>
+    static void forEachBit(uint64_t mask, size_t base, F &f)
+    {
+        while (mask)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            size_t k = (size_t)__builtin_ctzll(mask);
+#else
+            size_t k = 0;
+            while (!((mask >> k) & 1))
+                ++k;
+#endif
+            f(base + k);
+            mask &= mask - 1;
+        }
+    }
+
+    static uint64_t maskScalar(double px, double py, const double *xs, const double *ys,
+                               const double *radii, size_t n, double radius)
+    {
+        uint64_t mask = 0;
+        for (size_t k = 0; k < n; ++k)
+        {
+            double r = radii && radii[k] > radius ? radii[k] : radius;
+            double dx = xs[k] - px, dy = ys[k] - py;
+            if (dx * dx + dy * dy <= r * r)
+                mask |= uint64_t(1) << k;
+        }
+        return mask;
+    }
+
+#ifdef DISTANCE_KERNEL_X86
+    __attribute__((target("sse2"))) static uint64_t maskSSE2(double px, double py, const double *xs, const double *ys,
+                                                             const double *radii, size_t n, double radius)
+    {
+        const __m128d vpx = _mm_set1_pd(px), vpy = _mm_set1_pd(py), vr = _mm_set1_pd(radius);
+        uint64_t mask = 0;
+        size_t k = 0;
+        for (; k + 2 <= n; k += 2)
+        {
+            __m128d dx = _mm_sub_pd(_mm_loadu_pd(xs + k), vpx);
+            __m128d dy = _mm_sub_pd(_mm_loadu_pd(ys + k), vpy);
+            __m128d d2 = _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+            __m128d r = radii ? _mm_max_pd(_mm_loadu_pd(radii + k), vr) : vr;
+            __m128d le = _mm_cmple_pd(d2, _mm_mul_pd(r, r));
+            mask |= uint64_t(_mm_movemask_pd(le)) << k;
+        }
+        if (k < n)
+            mask |= maskScalar(px, py, xs + k, ys + k, radii ? radii + k : nullptr, n - k, radius) << k;
+        return mask;
+    }
+
+    __attribute__((target("avx2"))) static uint64_t maskAVX2(double px, double py, const double *xs, const double *ys,
+                                                             const double *radii, size_t n, double radius)
+    {
+        const __m256d vpx = _mm256_set1_pd(px), vpy = _mm256_set1_pd(py), vr = _mm256_set1_pd(radius);
+        uint64_t mask = 0;
+        size_t k = 0;
+        for (; k + 4 <= n; k += 4)
+        {
+            __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xs + k), vpx);
+            __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ys + k), vpy);
+            __m256d d2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+            __m256d r = radii ? _mm256_max_pd(_mm256_loadu_pd(radii + k), vr) : vr;
+            __m256d le = _mm256_cmp_pd(d2, _mm256_mul_pd(r, r), _CMP_LE_OQ);
+            mask |= uint64_t(_mm256_movemask_pd(le)) << k;
+        }
+        if (k < n)
+            mask |= maskScalar(px, py, xs + k, ys + k, radii ? radii + k : nullptr, n - k, radius) << k;
+        return mask;
+    }
+#endif
+};
@@ -7,12 +7,16 @@ class Druid : public NPC
 public:
     Druid(const std::string &name, double x, double y)
         : NPC(name, x, y, 80, 25) {}
+    Druid(NameId nameId, double x, double y)
+        : NPC(nameId, x, y, 80, 25) {}
 
     std::string getType() const override
     {
         return "Druid";
     }
 
+    NPCType getTypeTag() const override { return NPCType::Druid; }
+
     int getMoveRange() const override { return 10; }
     int getKillRange() const override { return 10; }
 
@@ -3,51 +3,148 @@
 #include <memory>
 #include <fstream>
 #include <algorithm>
+#include <iterator>
+#include <unordered_map>
 #include "NPC.h"
 #include "NPCFactory.h"
 #include "BattleVisitor.h"
 #include "Observer.h"
+#include "QuadTree.h"
+#include "EntityStore.h"
+#include "BinarySave.h"
+#include "TextLoader.h"
+#include "Metrics.h"
+
+// Формат файла сохранения: текст для обмена, двоичный для быстрой загрузки
+enum class SaveFormat
+{
+    Text,
+    Binary
+};
+
+// Описание NPC для пакетного добавления через addNPCs
+struct NPCSpec
+{
+    std::string type;
+    std::string name;
+    double x, y;
+};
 
 class DungeonEditor
 {
 private:
-    std::vector<std::shared_ptr<NPC>> npcs;
+    static constexpr double MAP_SIZE = 500.0;
+
+    // NPC в виде структуры массивов; дескрипторы служат ключами индекса
+    EntityStore npcs;
+    QuadTree index{0, 0, MAP_SIZE, MAP_SIZE};
     Subject subject;
+    uint64_t battleRound = 0; // Номер запуска боевого режима — тик для бросков
+    std::string lastLoadError;
+
+    // Индекс имён: NameId -> число NPC с этим именем (больше 1 только после
+    // загрузки файла с повторами). Проверка уникальности — O(1) вместо перебора
+    std::unordered_map<NameId, uint32_t> nameCounts;
+
+    static bool inBounds(double x, double y)
+    {
+        return x >= 0 && x <= MAP_SIZE && y >= 0 && y <= MAP_SIZE;
+    }
+
+    bool nameTaken(const std::string &name) const
+    {
+        // Имя, которого нет в таблице, заведомо не занято
+        NameId nameId = NameTable::global().find(name);
+        return nameId != INVALID_NAME && nameCounts.count(nameId) != 0;
+    }
+
+    void append(const std::shared_ptr<NPC> &npc)
+    {
+        EntityHandle handle = npcs.add(npc);
+        index.insert(handle, npc->getX(), npc->getY());
+        ++nameCounts[npc->getNameId()];
+    }
+
+    void forgetName(NameId nameId)
+    {
+        auto it = nameCounts.find(nameId);
+        if (it != nameCounts.end() && --it->second == 0)
+        {
+            nameCounts.erase(it);
+        }
+    }
+
+    void clearAll()
+    {
+        npcs.clear();
+        index.clear();
+        nameCounts.clear();
+    }
 
     void startBattleImpl(double range, BattleVisitor &battleVisitor)
     {
+        MetricsRegistry &registry = MetricsRegistry::global();
+        static Histogram &roundSeconds = registry.histogram("dungeon_editor_battle_round_seconds",
+                                                            "Длительность боевого режима редактора, с");
+        static Counter &rounds = registry.counter("dungeon_editor_battle_rounds_total", "Запуски боевого режима редактора");
+        static Counter &battles = registry.counter("dungeon_editor_battles_total", "Бои в боевом режиме редактора");
+        ScopedTimer timer(roundSeconds);
+        uint64_t fought = 0;
+
         std::cout << "\n=== НАЧАЛО БОЕВОГО РЕЖИМА ===" << std::endl;
         std::cout << "Дальность боя: " << range << " метров\n"
                   << std::endl;
 
         bool hadBattle = false;
 
-        // Проходим по всем парам NPC
+        // Проходим по парам NPC (i < j), найденным через пространственный индекс.
+        // Соседи сортируются по строке, поэтому порядок боёв совпадает с полным перебором.
+        std::vector<size_t> neighbours;
         for (size_t i = 0; i < npcs.size(); ++i)
         {
-            for (size_t j = i + 1; j < npcs.size(); ++j)
+            if (!npcs.isAlive(i))
+            {
+                continue;
+            }
+
+            neighbours.clear();
+            index.queryRadius(npcs.x(i), npcs.y(i), range,
+                              [this, &neighbours, i](size_t handle)
+                              {
+                                  size_t row = npcs.rowOf((EntityHandle)handle);
+                                  if (row > i)
+                                      neighbours.push_back(row);
+                              });
+            std::sort(neighbours.begin(), neighbours.end());
+
+            for (size_t j : neighbours)
             {
-                if (!npcs[i]->isAlive() || !npcs[j]->isAlive())
+                if (!npcs.isAlive(i) || !npcs.isAlive(j))
                 {
                     continue;
                 }
 
-                double distance = npcs[i]->distanceTo(*npcs[j]);
-                if (distance <= range)
-                {
-                    hadBattle = true;
-                    // Используем паттерн Visitor для боя
-                    npcs[i]->accept(battleVisitor, *npcs[j]);
-                }
+                hadBattle = true;
+                ++fought;
+                battleVisitor.setBattleContext(battleRound,
+                                               BattleVisitor::pairKey(npcs.handleAt(i), npcs.handleAt(j)));
+                // Используем паттерн Visitor для боя
+                npcs.object(i).accept(battleVisitor, npcs.object(j));
+                npcs.syncAlive(i);
+                npcs.syncAlive(j);
             }
         }
 
-        // Удаляем мёртвых NPC
-        npcs.erase(
-            std::remove_if(npcs.begin(), npcs.end(),
-                           [](const std::shared_ptr<NPC> &npc)
-                           { return !npc->isAlive(); }),
-            npcs.end());
+        ++battleRound;
+        rounds.add();
+        battles.add(fought);
+
+        // Удаляем мёртвых NPC из хранилища, пространственного индекса и индекса имён
+        npcs.compact([this](size_t row)
+                     {
+                         index.remove(npcs.handleAt(row), npcs.x(row), npcs.y(row));
+                         forgetName(npcs.nameId(row));
+                     });
 
         if (!hadBattle)
         {
@@ -70,44 +167,69 @@ public:
     // Добавление NPC
     bool addNPC(const std::string &type, const std::string &name, double x, double y)
     {
-        // Проверка координат
-        if (x < 0 || x > 500 || y < 0 || y > 500)
+        // Проверка координат и уникальности имени
+        if (!inBounds(x, y) || nameTaken(name))
         {
             return false;
         }
 
-        // Проверка уникальности имени
-        for (const auto &npc : npcs)
-        {
-            if (npc->getName() == name)
-            {
-                return false;
-            }
-        }
-
         auto npc = NPCFactory::createNPC(type, name, x, y);
         if (npc)
         {
-            npcs.push_back(npc);
+            append(npc);
             return true;
         }
         return false;
     }
 
+    // Пакетное добавление из диапазона NPCSpec: память резервируется один раз,
+    // координаты и уникальность (в том числе внутри пакета) проверяются за один проход.
+    // Некорректные элементы пропускаются; возвращает число добавленных NPC
+    template <class Range>
+    size_t addNPCs(const Range &specs)
+    {
+        using std::begin;
+        using std::end;
+        const size_t incoming = (size_t)std::distance(begin(specs), end(specs));
+        npcs.reserve(npcs.size() + incoming);
+        nameCounts.reserve(nameCounts.size() + incoming);
+
+        size_t added = 0;
+        for (const NPCSpec &spec : specs)
+        {
+            if (!inBounds(spec.x, spec.y) || nameTaken(spec.name))
+            {
+                continue;
+            }
+            auto npc = NPCFactory::createNPC(spec.type, spec.name, spec.x, spec.y);
+            if (npc)
+            {
+                append(npc);
+                ++added;
+            }
+        }
+        return added;
+    }
+
     // Сохранение в файл
-    bool saveToFile(const std::string &filename) const
+    bool saveToFile(const std::string &filename, SaveFormat format = SaveFormat::Text) const
     {
+        if (format == SaveFormat::Binary)
+        {
+            return BinarySave::write(filename, npcs);
+        }
+
         std::ofstream file(filename);
         if (!file.is_open())
         {
             return false;
         }
 
-        for (const auto &npc : npcs)
+        for (size_t i = 0; i < npcs.size(); ++i)
         {
-            if (npc->isAlive())
+            if (npcs.isAlive(i))
             {
-                file << npc->serialize() << std::endl;
+                file << npcs.object(i).serialize() << std::endl;
             }
         }
 
@@ -115,30 +237,62 @@ public:
         return true;
     }
 
-    // Загрузка из файла
+    // Загрузка из файла; формат (текстовый или двоичный) определяется по сигнатуре.
+    // При ошибке состояние редактора не меняется, причина — в getLoadError()
     bool loadFromFile(const std::string &filename)
     {
-        std::ifstream file(filename);
-        if (!file.is_open())
+        lastLoadError.clear();
+        MappedFile mapped(filename);
+        if (!mapped.isOpen())
         {
+            lastLoadError = filename + ": не удалось открыть файл";
             return false;
         }
 
-        npcs.clear();
-        std::string line;
-        while (std::getline(file, line))
+        if (BinarySave::isBinary(mapped.data(), mapped.size()))
         {
-            auto npc = NPCFactory::createFromString(line);
-            if (npc)
+            EntityStore loaded;
+            bool ok = BinarySave::read(mapped.data(), mapped.size(),
+                                       [&loaded](NPCType type, const std::string &name, double x, double y)
+                                       { loaded.add(NPCFactory::createNPC(type, name, x, y)); });
+            if (!ok)
             {
-                npcs.push_back(npc);
+                lastLoadError = filename + ": повреждённый двоичный файл";
+                return false;
             }
+
+            clearAll();
+            npcs.reserve(loaded.size());
+            for (size_t i = 0; i < loaded.size(); ++i)
+            {
+                append(loaded.objectPtr(i));
+            }
+            return true;
         }
 
-        file.close();
+        std::vector<TextLoader::Record> records;
+        TextLoader::Error error;
+        if (!TextLoader::parse(mapped.data(), mapped.size(), records, error))
+        {
+            lastLoadError = filename + ", строка " + std::to_string(error.line) + ": " + error.message;
+            return false;
+        }
+
+        clearAll();
+        npcs.reserve(records.size());
+        for (const auto &record : records)
+        {
+            append(NPCFactory::createNPC(record.type, std::string(record.name), record.x, record.y));
+        }
         return true;
     }
 
+    // Описание последней ошибки разбора в loadFromFile
+    const std::string &getLoadError() const
+    {
+        return lastLoadError;
+    }
+
     // Печать перечня объектов
     void printNPCs() const
     {
@@ -150,14 +304,15 @@ public:
 
         std::cout << "\n=== Список NPC ===" << std::endl;
         std::cout << "Всего NPC: " << npcs.size() << std::endl;
-        for (const auto &npc : npcs)
+        for (size_t i = 0; i < npcs.size(); ++i)
         {
-            if (npc->isAlive())
+            if (npcs.isAlive(i))
             {
-                std::cout << "- " << npc->getType()
-                          << " \"" << npc->getName() << "\" "
-                          << "в позиции (" << npc->getX() << ", " << npc->getY() << ")"
-                          << " [HP: " << npc->getHealth() << "]"
+                const NPC &npc = npcs.object(i);
+                std::cout << "- " << npc.getType()
+                          << " \"" << npc.getName() << "\" "
+                          << "в позиции (" << npcs.x(i) << ", " << npcs.y(i) << ")"
+                          << " [HP: " << npcs.health(i) << "]"
                           << std::endl;
             }
         }
@@ -7,12 +7,16 @@ class Elf : public NPC
 public:
     Elf(const std::string &name, double x, double y)
         : NPC(name, x, y, 70, 35) {}
+    Elf(NameId nameId, double x, double y)
+        : NPC(nameId, x, y, 70, 35) {}
 
     std::string getType() const override
     {
         return "Elf";
     }
 
+    NPCType getTypeTag() const override { return NPCType::Elf; }
+
     int getMoveRange() const override { return 10; }
     int getKillRange() const override { return 50; }
 
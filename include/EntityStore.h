@@ -0,0 +1,428 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include "NPC.h"
+
+// Дескриптор сущности в EntityStore: номер слота (младшие 24 бита) и поколение
+// слота (старшие 8 бит). Слот удалённой сущности переиспользуется с новым
+// поколением, поэтому старый дескриптор не указывает на новую сущность.
+// Слот, исчерпавший поколения, больше не выдаётся: иначе через 256
+// переиспользований старый дескриптор снова стал бы действительным.
+using EntityHandle = uint32_t;
+constexpr EntityHandle INVALID_ENTITY = std::numeric_limits<EntityHandle>::max();
+
+// Хранилище NPC в виде структуры массивов (SoA).
+// Горячие поля (координаты, здоровье, урон, флаг жизни, тег типа, имя, дальности)
+// лежат в отдельных непрерывных массивах и индексируются номером строки,
+// поэтому движение, поиск столкновений и отрисовка проходят по памяти линейно.
+//
+// Объекты NPC остаются адаптерами: через object(row) работают существующий
+// интерфейс NPC и диспетчеризация Visitor. Источник истины для координат и
+// флага жизни — массивы хранилища; syncObjects() переносит координаты в объекты.
+//
+// Погибшие строки сразу выпадают из плотного списка живых liveRows(), по
+// которому идут горячие циклы, поэтому их стоимость растёт с числом живых.
+// Сами строки удаляются позже: целиком через compact() или порциями через
+// compactStep(), когда доля мёртвых превышает DEAD_FRACTION. Слоты удалённых
+// сущностей попадают в список свободных.
+//
+// Хранилище рассчитано на одного владельца-писателя. Из других потоков
+// безопасен только reportDeath(): смерти применяются владельцем в applyDeaths().
+class EntityStore
+{
+public:
+    static constexpr size_t SLOT_BITS = 24;
+    static constexpr uint32_t SLOT_MASK = (uint32_t(1) << SLOT_BITS) - 1;
+    static constexpr uint8_t MAX_GENERATION = std::numeric_limits<uint8_t>::max();
+    // Доля мёртвых строк, после которой compactStep() начинает удаление
+    static constexpr double DEAD_FRACTION = 0.25;
+
+    static uint32_t slotOf(EntityHandle handle) { return handle & SLOT_MASK; }
+    static uint8_t generationOf(EntityHandle handle) { return (uint8_t)(handle >> SLOT_BITS); }
+
+private:
+    std::vector<double> xs, ys;
+    std::vector<int> healths, damages;
+    std::vector<uint8_t> alives;
+    std::vector<NPCType> types;
+    std::vector<NameId> nameIds;
+    std::vector<int> moveRanges, killRanges;
+    std::vector<std::shared_ptr<NPC>> objects;
+
+    std::vector<EntityHandle> rowHandles;  // Строка -> дескриптор
+    std::vector<uint32_t> slotRows;        // Слот -> строка (NO_ROW для свободных)
+    std::vector<uint8_t> slotGenerations;  // Слот -> текущее поколение
+    std::vector<uint32_t> freeSlots;
+
+    std::vector<uint32_t> live;            // Плотный список живых строк
+    std::vector<uint32_t> livePositions;   // Строка -> позиция в live (NO_ROW для мёртвых)
+    std::vector<EntityHandle> deadHandles; // Мёртвые, ещё не удалённые строки
+    std::vector<uint32_t> deadPositions;   // Строка -> позиция в deadHandles (NO_ROW для живых)
+    bool compacting = false;
+
+    std::mutex deaths_mutex;
+    std::vector<EntityHandle> pendingDeaths;
+
+    static constexpr uint32_t NO_ROW = std::numeric_limits<uint32_t>::max();
+
+    static EntityHandle makeHandle(uint32_t slot, uint8_t generation)
+    {
+        return ((EntityHandle)generation << SLOT_BITS) | slot;
+    }
+
+    void markDead(size_t row)
+    {
+        alives[row] = 0;
+        uint32_t pos = livePositions[row];
+        uint32_t moved = live.back();
+        live[pos] = moved;
+        livePositions[moved] = pos;
+        live.pop_back();
+        livePositions[row] = NO_ROW;
+        pushDead(row);
+    }
+
+    void pushDead(size_t row)
+    {
+        deadPositions[row] = (uint32_t)deadHandles.size();
+        deadHandles.push_back(rowHandles[row]);
+    }
+
+    // Снять строку из списка ожидающих удаления (воскрешение) за O(1)
+    void eraseDead(size_t row)
+    {
+        uint32_t pos = deadPositions[row];
+        if (pos == NO_ROW)
+            return;
+        EntityHandle moved = deadHandles.back();
+        deadHandles[pos] = moved;
+        deadPositions[rowOf(moved)] = pos;
+        deadHandles.pop_back();
+        deadPositions[row] = NO_ROW;
+    }
+
+    void markAlive(size_t row)
+    {
+        alives[row] = 1;
+        livePositions[row] = (uint32_t)live.size();
+        live.push_back((uint32_t)row);
+    }
+
+    // Слот удалённой сущности — в список свободных, со следующим поколением;
+    // слот с последним поколением выводится из оборота
+    void freeSlot(EntityHandle handle)
+    {
+        uint32_t slot = slotOf(handle);
+        slotRows[slot] = NO_ROW;
+        if (slotGenerations[slot] == MAX_GENERATION)
+            return;
+        ++slotGenerations[slot];
+        freeSlots.push_back(slot);
+    }
+
+    // Перенос строки from на место to (to уже освобождена)
+    void moveRow(size_t from, size_t to)
+    {
+        xs[to] = xs[from];
+        ys[to] = ys[from];
+        healths[to] = healths[from];
+        damages[to] = damages[from];
+        alives[to] = alives[from];
+        types[to] = types[from];
+        nameIds[to] = nameIds[from];
+        moveRanges[to] = moveRanges[from];
+        killRanges[to] = killRanges[from];
+        objects[to] = std::move(objects[from]);
+        rowHandles[to] = rowHandles[from];
+        slotRows[slotOf(rowHandles[to])] = (uint32_t)to;
+        livePositions[to] = livePositions[from];
+        if (livePositions[to] != NO_ROW)
+            live[livePositions[to]] = (uint32_t)to;
+        deadPositions[to] = deadPositions[from];
+    }
+
+    void resizeRows(size_t rows)
+    {
+        xs.resize(rows);
+        ys.resize(rows);
+        healths.resize(rows);
+        damages.resize(rows);
+        alives.resize(rows);
+        types.resize(rows);
+        nameIds.resize(rows);
+        moveRanges.resize(rows);
+        killRanges.resize(rows);
+        objects.resize(rows);
+        rowHandles.resize(rows);
+        livePositions.resize(rows);
+        deadPositions.resize(rows);
+    }
+
+public:
+    // Добавление NPC; возвращает его стабильный дескриптор
+    EntityHandle add(const std::shared_ptr<NPC> &npc)
+    {
+        uint32_t slot;
+        if (!freeSlots.empty())
+        {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else
+        {
+            if (slotRows.size() >= SLOT_MASK) // Последний слот занят INVALID_ENTITY
+            {
+                throw std::length_error("Переполнено хранилище NPC");
+            }
+            slot = (uint32_t)slotRows.size();
+            slotRows.push_back(NO_ROW);
+            slotGenerations.push_back(0);
+        }
+        EntityHandle handle = makeHandle(slot, slotGenerations[slot]);
+        const size_t row = xs.size();
+        slotRows[slot] = (uint32_t)row;
+        rowHandles.push_back(handle);
+
+        xs.push_back(npc->getX());
+        ys.push_back(npc->getY());
+        healths.push_back(npc->getHealth());
+        damages.push_back(npc->getDamage());
+        alives.push_back(0);
+        types.push_back(npc->getTypeTag());
+        nameIds.push_back(npc->getNameId());
+        moveRanges.push_back(npc->getMoveRange());
+        killRanges.push_back(npc->getKillRange());
+        objects.push_back(npc);
+        livePositions.push_back(NO_ROW);
+        deadPositions.push_back(NO_ROW);
+        if (npc->isAlive())
+            markAlive(row);
+        else
+            pushDead(row);
+        return handle;
+    }
+
+    void reserve(size_t capacity)
+    {
+        xs.reserve(capacity);
+        ys.reserve(capacity);
+        healths.reserve(capacity);
+        damages.reserve(capacity);
+        alives.reserve(capacity);
+        types.reserve(capacity);
+        nameIds.reserve(capacity);
+        moveRanges.reserve(capacity);
+        killRanges.reserve(capacity);
+        objects.reserve(capacity);
+        rowHandles.reserve(capacity);
+        livePositions.reserve(capacity);
+        deadPositions.reserve(capacity);
+        live.reserve(capacity);
+        slotRows.reserve(capacity);
+        slotGenerations.reserve(capacity);
+    }
+
+    void clear()
+    {
+        xs.clear();
+        ys.clear();
+        healths.clear();
+        damages.clear();
+        alives.clear();
+        types.clear();
+        nameIds.clear();
+        moveRanges.clear();
+        killRanges.clear();
+        objects.clear();
+        rowHandles.clear();
+        slotRows.clear();
+        slotGenerations.clear();
+        freeSlots.clear();
+        live.clear();
+        livePositions.clear();
+        deadHandles.clear();
+        deadPositions.clear();
+        compacting = false;
+        std::lock_guard<std::mutex> lock(deaths_mutex);
+        pendingDeaths.clear();
+    }
+
+    // Число строк, включая мёртвые, ещё не удалённые компактизацией
+    size_t size() const { return xs.size(); }
+    size_t liveCount() const { return live.size(); }
+    size_t deadCount() const { return deadHandles.size(); }
+    // Число слотов (верхняя граница slotOf() для выданных дескрипторов)
+    size_t slotCount() const { return slotRows.size(); }
+    bool empty() const { return xs.empty(); }
+
+    // Строки живых NPC; порядок не совпадает с порядком строк
+    const std::vector<uint32_t> &liveRows() const { return live; }
+
+    // Преобразования дескриптор <-> строка
+    EntityHandle handleAt(size_t row) const { return rowHandles[row]; }
+    bool contains(EntityHandle handle) const
+    {
+        uint32_t slot = slotOf(handle);
+        return slot < slotRows.size() && slotRows[slot] != NO_ROW &&
+               slotGenerations[slot] == generationOf(handle);
+    }
+    size_t rowOf(EntityHandle handle) const { return slotRows[slotOf(handle)]; }
+
+    // Доступ к столбцам
+    const std::vector<double> &xData() const { return xs; }
+    const std::vector<double> &yData() const { return ys; }
+
+    double x(size_t row) const { return xs[row]; }
+    double y(size_t row) const { return ys[row]; }
+    int health(size_t row) const { return healths[row]; }
+    int damage(size_t row) const { return damages[row]; }
+    bool isAlive(size_t row) const { return alives[row] != 0; }
+    NPCType type(size_t row) const { return types[row]; }
+    NameId nameId(size_t row) const { return nameIds[row]; }
+    int moveRange(size_t row) const { return moveRanges[row]; }
+    int killRange(size_t row) const { return killRanges[row]; }
+
+    // Адаптер к объектной модели: NPC для Visitor и вывода имени
+    NPC &object(size_t row) const { return *objects[row]; }
+    const std::shared_ptr<NPC> &objectPtr(size_t row) const { return objects[row]; }
+
+    // Перемещение с ограничением границами карты (как NPC::move)
+    void move(size_t row, double dx, double dy, double mapWidth, double mapHeight)
+    {
+        double nx = xs[row] + dx;
+        double ny = ys[row] + dy;
+        xs[row] = nx < 0 ? 0 : (nx > mapWidth ? mapWidth : nx);
+        ys[row] = ny < 0 ? 0 : (ny > mapHeight ? mapHeight : ny);
+    }
+
+    void setAlive(size_t row, bool alive)
+    {
+        if (alive && !alives[row])
+        {
+            // Воскрешение: строка больше не ждёт удаления
+            eraseDead(row);
+            markAlive(row);
+        }
+        else if (!alive && alives[row])
+            markDead(row);
+    }
+
+    // Перенос флага жизни из объекта NPC после боя
+    void syncAlive(size_t row) { setAlive(row, objects[row]->isAlive()); }
+
+    // Сообщить о смерти из другого потока (например, из потока боёв)
+    void reportDeath(EntityHandle handle)
+    {
+        std::lock_guard<std::mutex> lock(deaths_mutex);
+        pendingDeaths.push_back(handle);
+    }
+
+    // Применить накопленные смерти; вызывается владельцем хранилища.
+    // Смерти применяются по порядку дескрипторов, а не по порядку сообщений:
+    // от него зависит порядок liveRows(), а значит и роли в найденных парах
+    void applyDeaths()
+    {
+        std::vector<EntityHandle> deaths;
+        {
+            std::lock_guard<std::mutex> lock(deaths_mutex);
+            deaths.swap(pendingDeaths);
+        }
+        std::sort(deaths.begin(), deaths.end());
+        for (EntityHandle handle : deaths)
+        {
+            if (contains(handle))
+            {
+                setAlive(rowOf(handle), false);
+            }
+        }
+    }
+
+    // Перенос координат из массивов в объекты NPC
+    void syncObjects()
+    {
+        for (size_t row = 0; row < xs.size(); ++row)
+        {
+            objects[row]->setPosition(xs[row], ys[row]);
+        }
+    }
+
+    // Удаление всех мёртвых строк с сохранением порядка живых.
+    // onRemove(row) вызывается для каждой удаляемой строки до её удаления.
+    template <class F>
+    void compact(F &&onRemove)
+    {
+        size_t out = 0;
+        for (size_t row = 0; row < xs.size(); ++row)
+        {
+            if (!alives[row])
+            {
+                onRemove(row);
+                freeSlot(rowHandles[row]);
+                continue;
+            }
+            if (out != row)
+            {
+                moveRow(row, out);
+            }
+            ++out;
+        }
+        resizeRows(out);
+        std::fill(deadPositions.begin(), deadPositions.end(), NO_ROW);
+        deadHandles.clear();
+        compacting = false;
+    }
+
+    // Порционная компактизация: начинается, когда доля мёртвых строк превышает
+    // DEAD_FRACTION, и за вызов удаляет не больше maxRows строк, перенося на их
+    // место последние строки (порядок строк не сохраняется). Продолжается на
+    // следующих вызовах, пока мёртвых строк не останется.
+    // Возвращает число удалённых строк.
+    template <class F>
+    size_t compactStep(size_t maxRows, F &&onRemove)
+    {
+        if (!compacting && (double)deadHandles.size() <= DEAD_FRACTION * (double)xs.size())
+        {
+            return 0;
+        }
+        compacting = true;
+
+        size_t removed = 0;
+        while (removed < maxRows && !deadHandles.empty())
+        {
+            EntityHandle handle = deadHandles.back();
+            size_t row = rowOf(handle);
+            deadHandles.pop_back();
+            deadPositions[row] = NO_ROW;
+            onRemove(row);
+            freeSlot(handle);
+
+            size_t last = xs.size() - 1;
+            if (row != last)
+            {
+                moveRow(last, row);
+            }
+            resizeRows(last);
+            ++removed;
+        }
+        if (deadHandles.empty())
+        {
+            compacting = false;
+        }
+        return removed;
+    }
+
+    size_t compactStep(size_t maxRows)
+    {
+        return compactStep(maxRows, [](size_t) {});
+    }
+
+    void compact()
+    {
+        compact([](size_t) {});
+    }
+};
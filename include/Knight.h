@@ -7,12 +7,16 @@ class Knight : public NPC
 public:
     Knight(const std::string &name, double x, double y)
         : NPC(name, x, y, 100, 30) {}
+    Knight(NameId nameId, double x, double y)
+        : NPC(nameId, x, y, 100, 30) {}
 
     std::string getType() const override
     {
         return "Knight";
     }
 
+    NPCType getTypeTag() const override { return NPCType::Knight; }
+
     int getMoveRange() const override { return 30; }
     int getKillRange() const override { return 10; }
 
@@ -0,0 +1,341 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Метрики времени работы: счётчики, показатели и гистограммы.
+// Запись — только relaxed-атомики без блокировок. Счётчики и гистограммы
+// разбиты на сегменты в отдельных кеш-линиях: каждый поток пишет в свой
+// сегмент, сумма считается лишь при выгрузке. Поэтому метрики можно не
+// выключать и на горячих путях.
+
+// Число сегментов; потоков больше — сегменты делятся по кругу
+constexpr size_t METRIC_SHARDS = 16;
+
+// Сегмент текущего потока
+inline size_t metricShard()
+{
+    static std::atomic<size_t> next{0};
+    static thread_local size_t shard = next.fetch_add(1, std::memory_order_relaxed) % METRIC_SHARDS;
+    return shard;
+}
+
+// Монотонный счётчик событий
+class Counter
+{
+private:
+    struct alignas(64) Cell
+    {
+        std::atomic<uint64_t> value{0};
+    };
+
+    Cell cells[METRIC_SHARDS];
+
+public:
+    void add(uint64_t n = 1)
+    {
+        cells[metricShard()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    uint64_t value() const
+    {
+        uint64_t sum = 0;
+        for (const auto &cell : cells)
+            sum += cell.value.load(std::memory_order_relaxed);
+        return sum;
+    }
+};
+
+// Текущее значение (глубина очереди, число живых NPC); одна атомарная ячейка
+class Gauge
+{
+private:
+    std::atomic<int64_t> current{0};
+
+public:
+    void set(int64_t value) { current.store(value, std::memory_order_relaxed); }
+    void add(int64_t n) { current.fetch_add(n, std::memory_order_relaxed); }
+    void sub(int64_t n) { current.fetch_sub(n, std::memory_order_relaxed); }
+    int64_t value() const { return current.load(std::memory_order_relaxed); }
+};
+
+// Гистограмма с фиксированными верхними границами корзин (как в Prometheus:
+// корзина le=b считает значения <= b). Корзины хранятся без накопления,
+// накопленные суммы считаются при выгрузке.
+class Histogram
+{
+public:
+    static constexpr size_t MAX_BOUNDS = 16;
+
+    // Суммарное состояние: cumulative[k] — значения <= bounds[k], последняя — все
+    struct Totals
+    {
+        std::vector<uint64_t> cumulative;
+        uint64_t count = 0;
+        double sum = 0;
+    };
+
+private:
+    struct alignas(64) Cell
+    {
+        std::atomic<uint64_t> buckets[MAX_BOUNDS + 1];
+        std::atomic<double> sum{0};
+
+        Cell()
+        {
+            for (auto &bucket : buckets)
+                bucket.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    std::vector<double> upper;
+    Cell cells[METRIC_SHARDS];
+
+public:
+    explicit Histogram(std::vector<double> bounds) : upper(std::move(bounds))
+    {
+        if (upper.empty() || upper.size() > MAX_BOUNDS || !std::is_sorted(upper.begin(), upper.end()))
+            throw std::invalid_argument("Границы гистограммы: от 1 до 16 значений по возрастанию");
+    }
+
+    // Границы start, start*factor, ... (count штук)
+    static std::vector<double> exponentialBounds(double start, double factor, size_t count)
+    {
+        std::vector<double> bounds(count);
+        for (size_t k = 0; k < count; ++k, start *= factor)
+            bounds[k] = start;
+        return bounds;
+    }
+
+    // Длительности от 1 мкс до ~1 с
+    static std::vector<double> secondsBounds()
+    {
+        return exponentialBounds(1e-6, 4.0, 11);
+    }
+
+    const std::vector<double> &bounds() const { return upper; }
+
+    void observe(double value)
+    {
+        Cell &cell = cells[metricShard()];
+        size_t bucket = (size_t)(std::lower_bound(upper.begin(), upper.end(), value) - upper.begin());
+        cell.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        // Сегмент пишет в основном один поток, поэтому цикл почти не повторяется
+        double sum = cell.sum.load(std::memory_order_relaxed);
+        while (!cell.sum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    Totals totals() const
+    {
+        Totals result;
+        result.cumulative.assign(upper.size() + 1, 0);
+        for (const auto &cell : cells)
+        {
+            for (size_t k = 0; k <= upper.size(); ++k)
+                result.cumulative[k] += cell.buckets[k].load(std::memory_order_relaxed);
+            result.sum += cell.sum.load(std::memory_order_relaxed);
+        }
+        for (size_t k = 1; k < result.cumulative.size(); ++k)
+            result.cumulative[k] += result.cumulative[k - 1];
+        result.count = result.cumulative.back();
+        return result;
+    }
+};
+
+// Замер длительности области в секундах
+class ScopedTimer
+{
+private:
+    Histogram &histogram;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit ScopedTimer(Histogram &histogram)
+        : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+
+    ~ScopedTimer()
+    {
+        histogram.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+};
+
+// Реестр метрик программы.
+// Метрика задаётся именем и строкой меток ("type=\"Knight\""); повторная
+// регистрация возвращает ту же метрику, поэтому ссылку достаточно получить
+// один раз и хранить; пустое описание дополняется при следующей регистрации.
+// Метрики не удаляются, ссылки действительны всё время работы.
+// Мьютекс берётся только при регистрации и выгрузке.
+class MetricsRegistry
+{
+private:
+    enum class Kind
+    {
+        Counter,
+        Gauge,
+        Histogram
+    };
+
+    struct Series
+    {
+        std::string labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    struct Family
+    {
+        std::string name;
+        std::string help;
+        Kind kind;
+        std::vector<Series> series;
+    };
+
+    mutable std::mutex mtx;
+    std::vector<Family> families;
+
+    static const char *kindName(Kind kind)
+    {
+        switch (kind)
+        {
+        case Kind::Counter:
+            return "counter";
+        case Kind::Gauge:
+            return "gauge";
+        case Kind::Histogram:
+            return "histogram";
+        }
+        return "untyped";
+    }
+
+    // Серия с данными метками; новая создаётся пустой. Вызывается под mtx
+    Series &series(const std::string &name, const std::string &help, Kind kind, const std::string &labels)
+    {
+        auto family = std::find_if(families.begin(), families.end(),
+                                   [&name](const Family &f)
+                                   { return f.name == name; });
+        if (family == families.end())
+        {
+            families.push_back(Family{name, help, kind, {}});
+            family = families.end() - 1;
+        }
+        else if (family->kind != kind)
+        {
+            throw std::logic_error("Метрика " + name + " уже зарегистрирована с другим типом");
+        }
+        else if (family->help.empty())
+        {
+            family->help = help;
+        }
+
+        for (auto &s : family->series)
+        {
+            if (s.labels == labels)
+                return s;
+        }
+        family->series.push_back(Series{labels, nullptr, nullptr, nullptr});
+        return family->series.back();
+    }
+
+    // "{метки}" или "{метки,extra}"; пусто, если меток нет
+    static std::string braces(const std::string &labels, const std::string &extra = std::string())
+    {
+        if (labels.empty() && extra.empty())
+            return std::string();
+        if (labels.empty() || extra.empty())
+            return "{" + labels + extra + "}";
+        return "{" + labels + "," + extra + "}";
+    }
+
+public:
+    // Общий реестр программы
+    static MetricsRegistry &global()
+    {
+        static MetricsRegistry registry;
+        return registry;
+    }
+
+    Counter &counter(const std::string &name, const std::string &help, const std::string &labels = std::string())
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        Series &s = series(name, help, Kind::Counter, labels);
+        if (!s.counter)
+            s.counter = std::make_unique<Counter>();
+        return *s.counter;
+    }
+
+    Gauge &gauge(const std::string &name, const std::string &help, const std::string &labels = std::string())
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        Series &s = series(name, help, Kind::Gauge, labels);
+        if (!s.gauge)
+            s.gauge = std::make_unique<Gauge>();
+        return *s.gauge;
+    }
+
+    // Границы задаются при первой регистрации серии
+    Histogram &histogram(const std::string &name, const std::string &help,
+                         const std::vector<double> &bounds = Histogram::secondsBounds(),
+                         const std::string &labels = std::string())
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        Series &s = series(name, help, Kind::Histogram, labels);
+        if (!s.histogram)
+            s.histogram = std::make_unique<Histogram>(bounds);
+        return *s.histogram;
+    }
+
+    // Все метрики в текстовом формате Prometheus (version 0.0.4)
+    std::string exposition() const
+    {
+        std::ostringstream out;
+        out << std::setprecision(10);
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const auto &family : families)
+        {
+            out << "# HELP " << family.name << " " << family.help << "\n"
+                << "# TYPE " << family.name << " " << kindName(family.kind) << "\n";
+            for (const auto &s : family.series)
+            {
+                if (s.counter)
+                {
+                    out << family.name << braces(s.labels) << " " << s.counter->value() << "\n";
+                }
+                else if (s.gauge)
+                {
+                    out << family.name << braces(s.labels) << " " << s.gauge->value() << "\n";
+                }
+                else if (s.histogram)
+                {
+                    Histogram::Totals totals = s.histogram->totals();
+                    const std::vector<double> &bounds = s.histogram->bounds();
+                    for (size_t k = 0; k < bounds.size(); ++k)
+                    {
+                        std::ostringstream le;
+                        le << std::setprecision(10) << bounds[k];
+                        out << family.name << "_bucket" << braces(s.labels, "le=\"" + le.str() + "\"")
+                            << " " << totals.cumulative[k] << "\n";
+                    }
+                    out << family.name << "_bucket" << braces(s.labels, "le=\"+Inf\"") << " " << totals.count << "\n"
+                        << family.name << "_sum" << braces(s.labels) << " " << totals.sum << "\n"
+                        << family.name << "_count" << braces(s.labels) << " " << totals.count << "\n";
+                }
+            }
+        }
+        return out.str();
+    }
+};
@@ -0,0 +1,222 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Metrics.h"
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+// Выгрузка MetricsRegistry в текстовом формате Prometheus.
+// Фоновый поток раз в interval переписывает файл (через временный файл и
+// rename, чтобы сборщик не прочитал половину) и/или отвечает на HTTP-запросы
+// GET /metrics на 127.0.0.1:port. Порт 0 — любой свободный, см. port().
+// HTTP-выгрузка есть только на POSIX-системах.
+class MetricsExporter
+{
+private:
+    MetricsRegistry &registry;
+    const std::string filename;
+    const std::chrono::milliseconds interval;
+    int listenPort;
+    int listenFd = -1;
+
+    std::atomic<bool> stopped{false};
+    std::mutex wait_mutex;
+    std::condition_variable cv;
+    std::thread worker;
+
+    // Ожидание HTTP-подключения не дольше этого, чтобы вовремя заметить остановку
+    static constexpr int POLL_MS = 100;
+
+#ifndef _WIN32
+    bool listenLocal(int port)
+    {
+        listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (listenFd < 0)
+            return false;
+        int yes = 1;
+        ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons((uint16_t)port);
+        socklen_t length = sizeof(address);
+        if (::bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd, 8) != 0 ||
+            ::getsockname(listenFd, reinterpret_cast<sockaddr *>(&address), &length) != 0)
+        {
+            ::close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        listenPort = ntohs(address.sin_port);
+        return true;
+    }
+
+    static void sendAll(int fd, const std::string &bytes)
+    {
+        size_t done = 0;
+        while (done < bytes.size())
+        {
+            ssize_t sent = ::send(fd, bytes.data() + done, bytes.size() - done, MSG_NOSIGNAL);
+            if (sent <= 0)
+                return;
+            done += (size_t)sent;
+        }
+    }
+
+    // Один запрос на подключение: читается только строка запроса
+    void serve(int client)
+    {
+        timeval timeout{1, 0};
+        ::setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        std::string request;
+        char chunk[1024];
+        while (request.find("\r\n") == std::string::npos && request.size() < 8192)
+        {
+            ssize_t received = ::recv(client, chunk, sizeof(chunk), 0);
+            if (received <= 0)
+                break;
+            request.append(chunk, (size_t)received);
+        }
+
+        std::string status = "200 OK", body;
+        if (request.rfind("GET /metrics ", 0) == 0 || request.rfind("GET / ", 0) == 0)
+            body = registry.exposition();
+        else
+            status = "404 Not Found";
+
+        sendAll(client, "HTTP/1.1 " + status + "\r\n"
+                        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                        "Connection: close\r\n\r\n" + body);
+        ::close(client);
+    }
+#endif
+
+    // Ожидание до момента until: с HTTP — разбор подключений, иначе сон
+    void waitUntil(std::chrono::steady_clock::time_point until)
+    {
+#ifndef _WIN32
+        if (listenFd >= 0)
+        {
+            while (!stopped.load(std::memory_order_acquire) && std::chrono::steady_clock::now() < until)
+            {
+                pollfd fd{listenFd, POLLIN, 0};
+                if (::poll(&fd, 1, POLL_MS) > 0 && (fd.revents & POLLIN))
+                {
+                    int client = ::accept(listenFd, nullptr, nullptr);
+                    if (client >= 0)
+                        serve(client);
+                }
+            }
+            return;
+        }
+#endif
+        std::unique_lock<std::mutex> lock(wait_mutex);
+        cv.wait_until(lock, until, [this]
+                      { return stopped.load(std::memory_order_acquire); });
+    }
+
+    void loop()
+    {
+        auto next = std::chrono::steady_clock::now();
+        while (!stopped.load(std::memory_order_acquire))
+        {
+            if (!filename.empty() && std::chrono::steady_clock::now() >= next)
+            {
+                writeFile(registry, filename);
+                next += interval;
+            }
+            waitUntil(filename.empty() ? std::chrono::steady_clock::now() + interval : next);
+        }
+    }
+
+public:
+    // filename пусто — без файла; port < 0 — без HTTP
+    MetricsExporter(MetricsRegistry &registry, const std::string &filename, int port,
+                    std::chrono::milliseconds interval = std::chrono::milliseconds(1000))
+        : registry(registry), filename(filename), interval(interval), listenPort(port) {}
+
+    ~MetricsExporter()
+    {
+        stop();
+    }
+
+    MetricsExporter(const MetricsExporter &) = delete;
+    MetricsExporter &operator=(const MetricsExporter &) = delete;
+
+    // Запуск фонового потока; false — не удалось открыть HTTP-порт
+    bool start()
+    {
+        if (listenPort >= 0)
+        {
+#ifndef _WIN32
+            if (!listenLocal(listenPort))
+                return false;
+#else
+            return false;
+#endif
+        }
+        worker = std::thread(&MetricsExporter::loop, this);
+        return true;
+    }
+
+    // Остановка с последней записью файла
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(wait_mutex);
+            if (stopped.exchange(true, std::memory_order_acq_rel))
+                return;
+        }
+        cv.notify_one();
+        if (worker.joinable())
+            worker.join();
+#ifndef _WIN32
+        if (listenFd >= 0)
+        {
+            ::close(listenFd);
+            listenFd = -1;
+        }
+#endif
+        if (!filename.empty())
+            writeFile(registry, filename);
+    }
+
+    // Порт HTTP-выгрузки (после start(), в том числе выбранный для порта 0)
+    int port() const { return listenPort; }
+
+    // Запись реестра в файл целиком через временный файл рядом с ним
+    static bool writeFile(const MetricsRegistry &registry, const std::string &filename)
+    {
+        const std::string temporary = filename + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file.is_open())
+                return false;
+            file << registry.exposition();
+            if (!file)
+                return false;
+        }
+#ifdef _WIN32
+        // rename в Windows не заменяет существующий файл
+        std::remove(filename.c_str());
+#endif
+        return std::rename(temporary.c_str(), filename.c_str()) == 0;
+    }
+};
@@ -2,60 +2,119 @@
 #include <string>
 #include <memory>
 #include <cmath>
-#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include "NameTable.h"
 
 class Visitor;
 
-// Базовый класс для всех NPC
-class NPC
+// Компактный идентификатор NPC; назначается NPCFactory
+using NPCId = uint32_t;
+constexpr NPCId INVALID_NPC_ID = std::numeric_limits<NPCId>::max();
+
+// Тег типа NPC: компактная замена строкового getType() для горячих циклов
+enum class NPCType : uint8_t
 {
-protected:
-    std::string name;
-    double x, y;
-    int health;
-    int damage;
-    bool alive;
-    mutable std::mutex mtx; // Мьютекс для защиты доступа к данным NPC
+    Knight,
+    Druid,
+    Elf
+};
 
-public:
-    NPC(const std::string &name, double x, double y, int health, int damage)
-        : name(name), x(x), y(y), health(health), damage(damage), alive(true) {}
+constexpr int NPC_TYPE_COUNT = 3;
 
-    virtual ~NPC() = default;
+// Имя типа по тегу — то же, что возвращает getType()
+inline const char *npcTypeName(NPCType type)
+{
+    static const char *const NAMES[NPC_TYPE_COUNT] = {"Knight", "Druid", "Elf"};
+    return NAMES[(int)type];
+}
 
-    // Геттеры (потокобезопасные)
-    std::string getName() const
-    {
-        std::lock_guard<std::mutex> lock(mtx);
-        return name;
-    }
+// Координаты NPC, прочитанные согласованно
+struct Position
+{
+    double x, y;
+};
 
-    double getX() const
+// Базовый класс для всех NPC.
+// Состояние читается без блокировок: флаг жизни, здоровье и урон — атомарные,
+// координаты публикуются через seqlock, поэтому getPosition() всегда
+// возвращает пару (x, y) из одной записи. Пишут только move/setPosition
+// (под seqlock) и takeDamage/kill (атомарно).
+// Для согласованных изменений нескольких NPC сразу (бой) нужна внешняя
+// синхронизация уровнем выше: раунды без общих NPC (BattleRounds), захват
+// участников (BattleClaims) или единственный владелец-писатель (EntityStore).
+class NPC
+{
+protected:
+    NameId nameId; // Имя хранится в NameTable
+    NPCId id = INVALID_NPC_ID;
+    std::atomic<double> x, y;
+    std::atomic<int> health;
+    std::atomic<int> damage;
+    std::atomic<bool> alive;
+    mutable std::atomic<uint32_t> positionSeq{0}; // Нечётное — идёт запись координат
+
+    // Захват seqlock писателем; писатели координат сериализуются между собой
+    uint32_t beginPositionWrite()
     {
-        std::lock_guard<std::mutex> lock(mtx);
-        return x;
+        uint32_t seq = positionSeq.load(std::memory_order_relaxed);
+        while ((seq & 1) || !positionSeq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire))
+        {
+            seq = positionSeq.load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        return seq + 1;
     }
 
-    double getY() const
+    void endPositionWrite(uint32_t seq)
     {
-        std::lock_guard<std::mutex> lock(mtx);
-        return y;
+        positionSeq.store(seq + 1, std::memory_order_release);
     }
 
-    int getHealth() const
-    {
-        std::lock_guard<std::mutex> lock(mtx);
-        return health;
-    }
+public:
+    NPC(const std::string &name, double x, double y, int health, int damage)
+        : nameId(NameTable::global().intern(name)), x(x), y(y), health(health), damage(damage), alive(true) {}
+
+    // Для уже интернированного имени (пакетное создание без захвата NameTable)
+    NPC(NameId nameId, double x, double y, int health, int damage)
+        : nameId(nameId), x(x), y(y), health(health), damage(damage), alive(true) {}
 
-    bool isAlive() const
+    virtual ~NPC() = default;
+
+    // Имя и идентификаторы неизменяемы и читаются без блокировки
+    const std::string &getName() const { return NameTable::global().name(nameId); }
+    NameId getNameId() const { return nameId; }
+    NPCId getId() const { return id; }
+
+    // Назначение идентификатора; вызывается NPCFactory при создании
+    void setId(NPCId newId) { id = newId; }
+
+    // Согласованный снимок координат: повтор, если чтение пересеклось с записью
+    Position getPosition() const
     {
-        std::lock_guard<std::mutex> lock(mtx);
-        return alive;
+        while (true)
+        {
+            uint32_t before = positionSeq.load(std::memory_order_acquire);
+            if (before & 1)
+                continue;
+            Position pos{x.load(std::memory_order_relaxed), y.load(std::memory_order_relaxed)};
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (positionSeq.load(std::memory_order_relaxed) == before)
+                return pos;
+        }
     }
 
+    // Геттеры (потокобезопасные, без блокировок)
+    double getX() const { return getPosition().x; }
+    double getY() const { return getPosition().y; }
+    int getHealth() const { return health.load(std::memory_order_acquire); }
+    bool isAlive() const { return alive.load(std::memory_order_acquire); }
+    int getDamage() const { return damage.load(std::memory_order_relaxed); }
+
     // Метод для получения типа NPC
     virtual std::string getType() const = 0;
+    virtual NPCType getTypeTag() const = 0;
 
     // Получение характеристик движения
     virtual int getMoveRange() const = 0;
@@ -64,63 +123,62 @@ public:
     // Метод для вычисления расстояния до другого NPC
     double distanceTo(const NPC &other) const
     {
-        // Если это тот же объект, вернуть 0 без блокировки
         if (this == &other)
         {
             return 0.0;
         }
 
-        // Используем геттеры вместо прямого доступа к полям
-        double x1 = getX();
-        double y1 = getY();
-        double x2 = other.getX();
-        double y2 = other.getY();
+        // По одному согласованному чтению координат на каждого NPC
+        Position a = getPosition();
+        Position b = other.getPosition();
 
-        double dx = x1 - x2;
-        double dy = y1 - y2;
+        double dx = a.x - b.x;
+        double dy = a.y - b.y;
         return std::sqrt(dx * dx + dy * dy);
     }
 
     // Движение NPC
     void move(double dx, double dy, double mapWidth, double mapHeight)
     {
-        std::lock_guard<std::mutex> lock(mtx);
-        x += dx;
-        y += dy;
+        uint32_t seq = beginPositionWrite();
+        double nx = x.load(std::memory_order_relaxed) + dx;
+        double ny = y.load(std::memory_order_relaxed) + dy;
         // Ограничение на границы карты
-        if (x < 0)
-            x = 0;
-        if (x > mapWidth)
-            x = mapWidth;
-        if (y < 0)
-            y = 0;
-        if (y > mapHeight)
-            y = mapHeight;
+        if (nx < 0)
+            nx = 0;
+        if (nx > mapWidth)
+            nx = mapWidth;
+        if (ny < 0)
+            ny = 0;
+        if (ny > mapHeight)
+            ny = mapHeight;
+        x.store(nx, std::memory_order_relaxed);
+        y.store(ny, std::memory_order_relaxed);
+        endPositionWrite(seq);
+    }
+
+    // Перенос NPC в заданную точку (синхронизация с внешним хранилищем)
+    void setPosition(double newX, double newY)
+    {
+        uint32_t seq = beginPositionWrite();
+        x.store(newX, std::memory_order_relaxed);
+        y.store(newY, std::memory_order_relaxed);
+        endPositionWrite(seq);
     }
 
     // Получение урона
     void takeDamage(int dmg)
     {
-        std::lock_guard<std::mutex> lock(mtx);
-        health -= dmg;
-        if (health <= 0)
+        if (health.fetch_sub(dmg, std::memory_order_acq_rel) - dmg <= 0)
         {
-            alive = false;
+            alive.store(false, std::memory_order_release);
         }
     }
 
     // Убийство NPC (отметить как мертвого)
     void kill()
     {
-        std::lock_guard<std::mutex> lock(mtx);
-        alive = false;
-    }
-
-    // Нанесение урона другому NPC
-    int getDamage() const
-    {
-        std::lock_guard<std::mutex> lock(mtx);
-        return damage;
+        alive.store(false, std::memory_order_release);
     }
 
     // Метод для паттерна Visitor
@@ -129,10 +187,7 @@ public:
     // Сериализация
     virtual std::string serialize() const
     {
-        std::lock_guard<std::mutex> lock(mtx);
-        return getType() + " " + name + " " + std::to_string(x) + " " + std::to_string(y);
+        Position pos = getPosition();
+        return getType() + " " + getName() + " " + std::to_string(pos.x) + " " + std::to_string(pos.y);
     }
-
-    // Получить мьютекс для внешней синхронизации
-    std::mutex &getMutex() const { return mtx; }
 };
@@ -1,43 +1,141 @@
 #pragma once
 #include <memory>
 #include <string>
-#include <sstream>
+#include <atomic>
 #include "NPC.h"
 #include "Knight.h"
 #include "Druid.h"
 #include "Elf.h"
+#include "TextLoader.h"
+#include "NPCPool.h"
+
+// Способ выделения памяти под объекты NPC
+enum class NPCAllocation
+{
+    Heap, // std::make_shared
+    Pool  // std::allocate_shared из SlabPool своего типа
+};
 
 // Паттерн Factory для создания NPC
+// Каждый созданный NPC получает уникальный NPCId
 class NPCFactory
 {
+private:
+    static std::atomic<NPCAllocation> &allocationMode()
+    {
+        static std::atomic<NPCAllocation> mode{NPCAllocation::Heap};
+        return mode;
+    }
+
+    template <class T, class... Args>
+    static std::shared_ptr<T> make(Args &&...args)
+    {
+        if (allocationMode().load(std::memory_order_relaxed) == NPCAllocation::Pool)
+            return std::allocate_shared<T>(PoolAllocator<T>(), std::forward<Args>(args)...);
+        return std::make_shared<T>(std::forward<Args>(args)...);
+    }
+
+    static std::atomic<NPCId> &idCounter()
+    {
+        static std::atomic<NPCId> counter{0};
+        return counter;
+    }
+
+    static NPCId nextId()
+    {
+        return idCounter().fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static std::shared_ptr<NPC> withId(std::shared_ptr<NPC> npc)
+    {
+        npc->setId(nextId());
+        return npc;
+    }
+
 public:
+    // Режим выделения для следующих созданий; уже созданные NPC освобождаются
+    // тем способом, которым были выделены
+    static void setAllocation(NPCAllocation mode)
+    {
+        allocationMode().store(mode, std::memory_order_relaxed);
+    }
+
+    static NPCAllocation allocation()
+    {
+        return allocationMode().load(std::memory_order_relaxed);
+    }
+
     static std::shared_ptr<NPC> createNPC(const std::string &type, const std::string &name, double x, double y)
     {
         if (type == "Knight")
         {
-            return std::make_shared<Knight>(name, x, y);
+            return withId(make<Knight>(name, x, y));
         }
         else if (type == "Druid")
         {
-            return std::make_shared<Druid>(name, x, y);
+            return withId(make<Druid>(name, x, y));
         }
         else if (type == "Elf")
         {
-            return std::make_shared<Elf>(name, x, y);
+            return withId(make<Elf>(name, x, y));
+        }
+        return nullptr;
+    }
+
+    // Создание по тегу типа — без сравнения строк
+    static std::shared_ptr<NPC> createNPC(NPCType type, const std::string &name, double x, double y)
+    {
+        switch (type)
+        {
+        case NPCType::Knight:
+            return withId(make<Knight>(name, x, y));
+        case NPCType::Druid:
+            return withId(make<Druid>(name, x, y));
+        case NPCType::Elf:
+            return withId(make<Elf>(name, x, y));
         }
         return nullptr;
     }
 
+    // Резерв count последовательных идентификаторов; возвращает первый
+    static NPCId reserveIds(size_t count)
+    {
+        return idCounter().fetch_add((NPCId)count, std::memory_order_relaxed);
+    }
+
+    // Пакетное создание: имя уже интернировано, идентификатор выдан reserveIds.
+    // Не обращается к общим счётчикам и таблицам — безопасно из любого потока
+    static std::shared_ptr<NPC> createNPC(NPCType type, NameId nameId, double x, double y, NPCId id)
+    {
+        std::shared_ptr<NPC> npc;
+        switch (type)
+        {
+        case NPCType::Knight:
+            npc = make<Knight>(nameId, x, y);
+            break;
+        case NPCType::Druid:
+            npc = make<Druid>(nameId, x, y);
+            break;
+        case NPCType::Elf:
+            npc = make<Elf>(nameId, x, y);
+            break;
+        }
+        if (npc)
+        {
+            npc->setId(id);
+        }
+        return npc;
+    }
+
     // Создание NPC из строки файла
     static std::shared_ptr<NPC> createFromString(const std::string &line)
     {
-        std::istringstream iss(line);
-        std::string type, name;
-        double x, y;
-
-        if (iss >> type >> name >> x >> y)
+        TextLoader::Record record;
+        bool empty = false;
+        std::string message;
+        if (TextLoader::parseLine(line, record, empty, message) && !empty)
         {
-            return createNPC(type, name, x, y);
+            return createNPC(record.type, std::string(record.name), record.x, record.y);
         }
         return nullptr;
     }
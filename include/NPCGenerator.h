@@ -0,0 +1,71 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "NPC.h"
+#include "NPCFactory.h"
+#include "CounterRng.h"
+#include "ParallelFor.h"
+
+// Пакетная генерация случайных NPC для больших миров.
+// Тип и координаты NPC с номером i — функция от (seed, i) через CounterRng,
+// поэтому результат не зависит от числа потоков и порядка их работы.
+// Работа идёт в три прохода по заранее выделенным массивам:
+//   1) параллельно: тип, координаты и имя "Тип_N" для каждого номера;
+//   2) одним захватом NameTable: интернирование всех имён по порядку;
+//   3) параллельно: создание объектов с выданными NameId и NPCId.
+class NPCGenerator
+{
+public:
+    // Ключ потока CounterRng для генерации; движение использует номера тиков
+    static constexpr uint64_t STREAM = ~uint64_t(0);
+
+    // Генерация count NPC на карте width x height; threads = 0 — по числу ядер.
+    // Имена — "Тип_N", N начинается с firstNumber. NameTable не очищается:
+    // сквозная нумерация между вызовами добавляет в неё count новых имён каждый раз
+    static std::vector<std::shared_ptr<NPC>> generate(uint64_t seed, size_t count, double width, double height,
+                                                      unsigned threads = 0, size_t firstNumber = 1)
+    {
+        threads = parallelThreads(count, threads, MIN_PER_THREAD);
+
+        std::vector<NPCType> types(count);
+        std::vector<double> xs(count), ys(count);
+        std::vector<std::string> names(count);
+        parallelFor(count, threads, [&](unsigned, size_t begin, size_t end)
+                    {
+                        char digits[24];
+                        for (size_t i = begin; i < end; ++i)
+                        {
+                            types[i] = (NPCType)CounterRng::below(NPC_TYPE_COUNT, seed, STREAM, i, 0);
+                            xs[i] = CounterRng::uniform(seed, STREAM, i, 1) * width;
+                            ys[i] = CounterRng::uniform(seed, STREAM, i, 2) * height;
+
+                            auto number = std::to_chars(digits, digits + sizeof(digits), firstNumber + i);
+                            std::string &name = names[i];
+                            name.reserve(8 + (size_t)(number.ptr - digits));
+                            name = npcTypeName(types[i]);
+                            name += '_';
+                            name.append(digits, number.ptr);
+                        } });
+
+        std::vector<NameId> nameIds(count);
+        NameTable::global().internAll(names, nameIds.data());
+        names.clear();
+        names.shrink_to_fit();
+
+        const NPCId firstId = NPCFactory::reserveIds(count);
+        std::vector<std::shared_ptr<NPC>> npcs(count);
+        parallelFor(count, threads, [&](unsigned, size_t begin, size_t end)
+                    {
+                        for (size_t i = begin; i < end; ++i)
+                            npcs[i] = NPCFactory::createNPC(types[i], nameIds[i], xs[i], ys[i], firstId + (NPCId)i); });
+        return npcs;
+    }
+
+private:
+    // Меньшие объёмы быстрее сделать в одном потоке
+    static constexpr size_t MIN_PER_THREAD = 16384;
+};
@@ -0,0 +1,194 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// Пул блоков под объекты типа T (slab-аллокатор); у каждого типа свой пул,
+// даже если размеры типов совпадают.
+// Память выделяется слэбами по SLAB_BLOCKS блоков и нарезается в список свободных;
+// освобождённый блок возвращается в список и переиспользуется тем же типом,
+// поэтому при постоянном создании и гибели NPC куча не фрагментируется.
+// У каждого потока свой кэш свободных блоков: общий мьютекс берётся только
+// при обмене пакетами по BATCH блоков между кэшем и пулом.
+// Кэш возвращается в пул при завершении потока, в том числе потока,
+// который только освобождал блоки (потоки боёв).
+// Слэбы не освобождаются до конца программы.
+template <class T>
+class SlabPool
+{
+private:
+    struct FreeNode
+    {
+        FreeNode *next;
+    };
+
+    static constexpr size_t ALIGN = alignof(T) < alignof(FreeNode) ? alignof(FreeNode) : alignof(T);
+    static constexpr size_t BLOCK = ((sizeof(T) < sizeof(FreeNode) ? sizeof(FreeNode) : sizeof(T)) + ALIGN - 1) / ALIGN * ALIGN;
+    static constexpr size_t SLAB_BLOCKS = 1024;
+    static constexpr size_t BATCH = 64;
+
+    // Кэш потока; тривиально разрушаемый, чтобы освобождения во время
+    // завершения потока не обращались к уничтоженному объекту
+    struct Cache
+    {
+        FreeNode *head = nullptr;
+        size_t count = 0;
+    };
+
+    // Возврат кэша в пул при завершении потока
+    struct CacheFlusher
+    {
+        ~CacheFlusher()
+        {
+            Cache &cache = localCache();
+            instance().release(cache, cache.count);
+        }
+    };
+
+    std::mutex mtx;
+    FreeNode *freeList = nullptr;
+    size_t freeCount = 0;
+    std::vector<void *> slabs;
+    std::atomic<size_t> liveBlocks{0};
+
+    static Cache &localCache()
+    {
+        static thread_local Cache cache;
+        return cache;
+    }
+
+    // Регистрация возврата кэша при завершении текущего потока
+    static void registerFlusher()
+    {
+        static thread_local CacheFlusher flusher;
+        (void)flusher;
+    }
+
+    // Перенос пакета из BATCH блоков из пула в кэш потока; при нехватке — новый слэб
+    void refill(Cache &cache)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (freeCount < BATCH)
+        {
+            char *slab = static_cast<char *>(::operator new(BLOCK * SLAB_BLOCKS, std::align_val_t(ALIGN)));
+            slabs.push_back(slab);
+            for (size_t i = 0; i < SLAB_BLOCKS; ++i)
+            {
+                auto *node = reinterpret_cast<FreeNode *>(slab + i * BLOCK);
+                node->next = freeList;
+                freeList = node;
+            }
+            freeCount += SLAB_BLOCKS;
+        }
+        for (size_t i = 0; i < BATCH; ++i)
+        {
+            FreeNode *node = freeList;
+            freeList = node->next;
+            node->next = cache.head;
+            cache.head = node;
+        }
+        freeCount -= BATCH;
+        cache.count += BATCH;
+    }
+
+    // Возврат count блоков из кэша потока в пул
+    void release(Cache &cache, size_t count)
+    {
+        if (count == 0)
+            return;
+        std::lock_guard<std::mutex> lock(mtx);
+        for (size_t i = 0; i < count; ++i)
+        {
+            FreeNode *node = cache.head;
+            cache.head = node->next;
+            node->next = freeList;
+            freeList = node;
+        }
+        cache.count -= count;
+        freeCount += count;
+    }
+
+public:
+    // Пул живёт до конца программы: NPC могут освобождаться при разрушении статиков
+    static SlabPool &instance()
+    {
+        static SlabPool *pool = new SlabPool();
+        return *pool;
+    }
+
+    void *allocate()
+    {
+        registerFlusher();
+        Cache &cache = localCache();
+        if (!cache.head)
+            refill(cache);
+        FreeNode *node = cache.head;
+        cache.head = node->next;
+        --cache.count;
+        liveBlocks.fetch_add(1, std::memory_order_relaxed);
+        return node;
+    }
+
+    void deallocate(void *p)
+    {
+        registerFlusher();
+        Cache &cache = localCache();
+        auto *node = static_cast<FreeNode *>(p);
+        node->next = cache.head;
+        cache.head = node;
+        ++cache.count;
+        liveBlocks.fetch_sub(1, std::memory_order_relaxed);
+        if (cache.count > 2 * BATCH)
+            release(cache, BATCH);
+    }
+
+    // Занятые блоки и выделенные слэбы (для тестов и статистики)
+    size_t live() const { return liveBlocks.load(std::memory_order_relaxed); }
+    // Свободные блоки в общем списке (без кэшей потоков)
+    size_t pooled()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return freeCount;
+    }
+    size_t slabCount()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return slabs.size();
+    }
+};
+
+// Аллокатор для std::allocate_shared: одиночные объекты берутся из SlabPool
+// своего типа (NPC вместе с блоком счётчика ссылок), массивы — из кучи
+template <class T>
+class PoolAllocator
+{
+public:
+    using value_type = T;
+
+    PoolAllocator() = default;
+    template <class U>
+    PoolAllocator(const PoolAllocator<U> &) {}
+
+    T *allocate(size_t n)
+    {
+        if (n == 1)
+            return static_cast<T *>(SlabPool<T>::instance().allocate());
+        return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+    }
+
+    void deallocate(T *p, size_t n)
+    {
+        if (n == 1)
+            SlabPool<T>::instance().deallocate(p);
+        else
+            ::operator delete(p, std::align_val_t(alignof(T)));
+    }
+
+    template <class U>
+    bool operator==(const PoolAllocator<U> &) const { return true; }
+    template <class U>
+    bool operator!=(const PoolAllocator<U> &) const { return false; }
+};
@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Идентификатор интернированного имени
+using NameId = uint32_t;
+constexpr NameId INVALID_NAME = std::numeric_limits<NameId>::max();
+
+// Таблица интернированных имён NPC.
+// Каждая строка хранится один раз — в блоках таблицы; индекс поиска держит
+// только string_view на эти строки. NPC и события держат только NameId,
+// а текст получают через name() в момент вывода.
+// Имена не удаляются, поэтому ссылка из name() действительна всё время работы.
+// Память таблицы растёт с числом различных имён за всё время работы и не
+// возвращается: повторное имя получает прежний NameId и места не занимает.
+// Сбросить таблицу нельзя — NameId живут в NPC, снимках и очередях наблюдателей.
+// Генератор выдаёт имена "Тип_N" с N от 1, поэтому новые миры того же размера
+// переиспользуют имена; уникальные имена без повторов (например, со сквозным
+// номером) будут расти без границы — до length_error при MAX_CHUNKS блоках.
+// intern() и find() берут мьютекс; name() читает без блокировок:
+// строки лежат в блоках фиксированного размера, которые не перемещаются.
+class NameTable
+{
+private:
+    static constexpr size_t CHUNK_BITS = 12;
+    static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+    static constexpr size_t MAX_CHUNKS = 16384; // До 64M имён
+
+    std::unique_ptr<std::string[]> chunks[MAX_CHUNKS];
+    std::atomic<size_t> count{0};
+
+    std::mutex intern_mutex;
+    // Ключи указывают на строки блоков: блоки и строки в них не перемещаются
+    std::unordered_map<std::string_view, NameId> ids;
+
+    // Сохранение нового имени под номером id и добавление в индекс; под intern_mutex
+    NameId store(const std::string &name, size_t id)
+    {
+        if (id >= CHUNK_SIZE * MAX_CHUNKS)
+        {
+            throw std::length_error("Переполнена таблица имён NPC");
+        }
+        auto &chunk = chunks[id >> CHUNK_BITS];
+        if (!chunk)
+        {
+            chunk.reset(new std::string[CHUNK_SIZE]);
+        }
+        std::string &stored = chunk[id & (CHUNK_SIZE - 1)];
+        stored = name;
+        ids.emplace(std::string_view(stored), (NameId)id);
+        return (NameId)id;
+    }
+
+public:
+    // Общая таблица программы; одна на все миры и редакторы, не очищается
+    static NameTable &global()
+    {
+        static NameTable table;
+        return table;
+    }
+
+    // Идентификатор имени; новое имя добавляется в таблицу
+    NameId intern(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(intern_mutex);
+        auto it = ids.find(std::string_view(name));
+        if (it != ids.end())
+        {
+            return it->second;
+        }
+
+        size_t id = count.load(std::memory_order_relaxed);
+        NameId result = store(name, id);
+        count.store(id + 1, std::memory_order_release);
+        return result;
+    }
+
+    // Интернирование пакета имён под одним захватом мьютекса; out[i] — id names[i]
+    void internAll(const std::vector<std::string> &names, NameId *out)
+    {
+        std::lock_guard<std::mutex> lock(intern_mutex);
+        ids.reserve(ids.size() + names.size());
+        size_t id = count.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < names.size(); ++i)
+        {
+            auto it = ids.find(std::string_view(names[i]));
+            if (it != ids.end())
+            {
+                out[i] = it->second;
+                continue;
+            }
+            try
+            {
+                out[i] = store(names[i], id);
+            }
+            catch (...)
+            {
+                count.store(id, std::memory_order_release);
+                throw;
+            }
+            ++id;
+        }
+        count.store(id, std::memory_order_release);
+    }
+
+    // Идентификатор уже известного имени или INVALID_NAME
+    NameId find(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lock(intern_mutex);
+        auto it = ids.find(std::string_view(name));
+        return it != ids.end() ? it->second : INVALID_NAME;
+    }
+
+    const std::string &name(NameId id) const
+    {
+        return chunks[id >> CHUNK_BITS][id & (CHUNK_SIZE - 1)];
+    }
+
+    size_t size() const { return count.load(std::memory_order_acquire); }
+};
@@ -5,16 +5,64 @@
 #include <fstream>
 #include <iostream>
 #include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "NPC.h"
+#include "Metrics.h"
 
 // Глобальный мьютекс для вывода в консоль
 extern std::mutex cout_mutex;
 
+// Событие убийства: только POD-поля, без строк и выделений памяти.
+// Участники заданы идентификаторами; имена из NameTable подставляют лишь те
+// наблюдатели, которым нужен текст (formatKiller/formatVictim).
+struct KillEvent
+{
+    NPCId killerId;
+    NPCId victimId;
+    NameId killerName;
+    NameId victimName;
+    NPCType killerType;
+    NPCType victimType;
+    uint8_t attackRoll;
+    uint8_t defenseRoll;
+    bool byDefender; // Убил защищающийся (иначе — атакующий)
+    uint64_t tick;
+};
+
+// Текст событий в прежнем формате журнала: "Имя (Тип)"
+inline std::string formatKiller(const KillEvent &event)
+{
+    return NameTable::global().name(event.killerName) + " (" + npcTypeName(event.killerType) + ")";
+}
+
+// "Имя (Тип) [Атака:6 > Защита:1]"; для победы защищающегося броски в обратном порядке
+inline std::string formatVictim(const KillEvent &event)
+{
+    std::string text = NameTable::global().name(event.victimName) + " (" + npcTypeName(event.victimType) + ") [";
+    if (event.byDefender)
+    {
+        text += "Защита:" + std::to_string(event.defenseRoll) + " > Атака:" + std::to_string(event.attackRoll);
+    }
+    else
+    {
+        text += "Атака:" + std::to_string(event.attackRoll) + " > Защита:" + std::to_string(event.defenseRoll);
+    }
+    return text + "]";
+}
+
 // Интерфейс Observer
 class Observer
 {
 public:
     virtual ~Observer() = default;
     virtual void onKill(const std::string &killer, const std::string &victim) = 0;
+
+    // Структурированное событие; по умолчанию форматируется и передаётся в onKill
+    virtual void onKillEvent(const KillEvent &event)
+    {
+        onKill(formatKiller(event), formatVictim(event));
+    }
 };
 
 // Observer для записи в файл (потокобезопасный)
@@ -50,26 +98,82 @@ public:
     }
 };
 
-// Класс Subject для управления наблюдателями
+// Класс Subject для управления наблюдателями.
+// Список наблюдателей после публикации не меняется: attach() собирает новый
+// под мьютексом и подменяет указатель, notify() обходит текущий без блокировок,
+// так что потоки боёв не ждут друг друга на рассылке. Прежние списки живут до
+// конца Subject: рассылка, начатая до attach(), может ещё обходить их.
 class Subject
 {
 private:
-    std::vector<std::shared_ptr<Observer>> observers;
-    std::mutex observers_mutex;
+    using ObserverList = std::vector<std::shared_ptr<Observer>>;
+
+    std::atomic<const ObserverList *> observers;
+    std::vector<std::unique_ptr<const ObserverList>> lists; // Под attach_mutex
+    std::mutex attach_mutex;
+
+    // Метрики рассылки: время обхода наблюдателей, убийства и гибели по типам
+    struct Metrics
+    {
+        Histogram &notifySeconds;
+        Counter *kills[NPC_TYPE_COUNT];
+        Counter *deaths[NPC_TYPE_COUNT];
+    };
+
+    static Metrics &metrics()
+    {
+        static Metrics m = []
+        {
+            MetricsRegistry &registry = MetricsRegistry::global();
+            Metrics made{registry.histogram("dungeon_observer_notify_seconds",
+                                            "Время рассылки события всем наблюдателям, с"),
+                         {},
+                         {}};
+            for (int type = 0; type < NPC_TYPE_COUNT; ++type)
+            {
+                std::string label = std::string("type=\"") + npcTypeName((NPCType)type) + "\"";
+                made.kills[type] = &registry.counter("dungeon_kills_total", "Убийства по типу убийцы", label);
+                made.deaths[type] = &registry.counter("dungeon_deaths_total", "Гибели по типу жертвы", label);
+            }
+            return made;
+        }();
+        return m;
+    }
 
 public:
+    Subject()
+    {
+        lists.push_back(std::make_unique<const ObserverList>());
+        observers.store(lists.back().get(), std::memory_order_release);
+    }
+
     void attach(std::shared_ptr<Observer> observer)
     {
-        std::lock_guard<std::mutex> lock(observers_mutex);
-        observers.push_back(observer);
+        std::lock_guard<std::mutex> lock(attach_mutex);
+        auto list = std::make_unique<ObserverList>(*lists.back());
+        list->push_back(std::move(observer));
+        lists.push_back(std::move(list));
+        observers.store(lists.back().get(), std::memory_order_release);
     }
 
     void notify(const std::string &killer, const std::string &victim)
     {
-        std::lock_guard<std::mutex> lock(observers_mutex);
-        for (auto &observer : observers)
+        ScopedTimer timer(metrics().notifySeconds);
+        for (auto &observer : *observers.load(std::memory_order_acquire))
         {
             observer->onKill(killer, victim);
         }
     }
+
+    void notify(const KillEvent &event)
+    {
+        Metrics &m = metrics();
+        m.kills[(int)event.killerType]->add();
+        m.deaths[(int)event.victimType]->add();
+        ScopedTimer timer(m.notifySeconds);
+        for (auto &observer : *observers.load(std::memory_order_acquire))
+        {
+            observer->onKillEvent(event);
+        }
+    }
 };
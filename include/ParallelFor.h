@@ -0,0 +1,35 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Число потоков для параллельного прохода: threads = 0 — по числу ядер;
+// не больше, чем частей хотя бы по minPerThread элементов
+inline unsigned parallelThreads(size_t count, unsigned threads, size_t minPerThread)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    return (unsigned)std::max<size_t>(1, std::min<size_t>(threads, count / std::max<size_t>(1, minPerThread)));
+}
+
+// f(chunk, begin, end) для threads равных непрерывных частей [0, count);
+// часть chunk обрабатывает свой поток, с одним потоком — вызывающий
+template <class F>
+void parallelFor(size_t count, unsigned threads, F &&f)
+{
+    if (threads <= 1)
+    {
+        f(0u, size_t(0), count);
+        return;
+    }
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&f, count, threads, t]
+                             { f(t, count * t / threads, count * (t + 1) / threads); });
+    }
+    for (auto &worker : workers)
+        worker.join();
+}
@@ -0,0 +1,202 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include "DistanceKernel.h"
+
+// Квадродерево для запросов «все точки в радиусе r».
+// Листья хранят до BUCKET_SIZE точек в виде отдельных массивов координат,
+// при переполнении лист делится на четыре квадранта.
+// Точки вне заданных границ хранятся в отдельном списке и проверяются перебором.
+class QuadTree
+{
+private:
+    static constexpr size_t BUCKET_SIZE = 16;
+    static constexpr int MAX_DEPTH = 20;
+
+    struct Node
+    {
+        double minX, minY, maxX, maxY;
+        int firstChild = -1; // Индекс первого из четырёх потомков, -1 — лист
+        int depth = 0;
+        std::vector<double> xs, ys;
+        std::vector<size_t> keys;
+
+        Node(double minX, double minY, double maxX, double maxY, int depth)
+            : minX(minX), minY(minY), maxX(maxX), maxY(maxY), depth(depth) {}
+
+        bool contains(double x, double y) const
+        {
+            return x >= minX && x <= maxX && y >= minY && y <= maxY;
+        }
+    };
+
+    std::vector<Node> nodes;
+    Node outside; // Точки за пределами границ дерева
+    size_t count = 0;
+
+    static bool circleIntersects(const Node &node, double x, double y, double r)
+    {
+        double cx = std::max(node.minX, std::min(x, node.maxX));
+        double cy = std::max(node.minY, std::min(y, node.maxY));
+        double dx = x - cx, dy = y - cy;
+        return dx * dx + dy * dy <= r * r;
+    }
+
+    // Номер квадранта точки внутри узла
+    static int quadrant(const Node &node, double x, double y)
+    {
+        double midX = (node.minX + node.maxX) / 2;
+        double midY = (node.minY + node.maxY) / 2;
+        return (x > midX ? 1 : 0) + (y > midY ? 2 : 0);
+    }
+
+    void split(size_t n)
+    {
+        double minX = nodes[n].minX, minY = nodes[n].minY;
+        double maxX = nodes[n].maxX, maxY = nodes[n].maxY;
+        double midX = (minX + maxX) / 2, midY = (minY + maxY) / 2;
+        int depth = nodes[n].depth + 1;
+
+        int first = (int)nodes.size();
+        nodes.emplace_back(minX, minY, midX, midY, depth);
+        nodes.emplace_back(midX, minY, maxX, midY, depth);
+        nodes.emplace_back(minX, midY, midX, maxY, depth);
+        nodes.emplace_back(midX, midY, maxX, maxY, depth);
+
+        // После emplace_back ссылки на узлы могли стать недействительными
+        Node &node = nodes[n];
+        node.firstChild = first;
+        for (size_t i = 0; i < node.keys.size(); ++i)
+        {
+            Node &child = nodes[first + quadrant(node, node.xs[i], node.ys[i])];
+            child.xs.push_back(node.xs[i]);
+            child.ys.push_back(node.ys[i]);
+            child.keys.push_back(node.keys[i]);
+        }
+        node.xs.clear();
+        node.ys.clear();
+        node.keys.clear();
+    }
+
+    // Лист, в который попадает точка
+    size_t findLeaf(double x, double y) const
+    {
+        size_t n = 0;
+        while (nodes[n].firstChild >= 0)
+        {
+            n = nodes[n].firstChild + quadrant(nodes[n], x, y);
+        }
+        return n;
+    }
+
+    static bool eraseFrom(Node &node, size_t key)
+    {
+        for (size_t i = 0; i < node.keys.size(); ++i)
+        {
+            if (node.keys[i] == key)
+            {
+                node.xs[i] = node.xs.back();
+                node.ys[i] = node.ys.back();
+                node.keys[i] = node.keys.back();
+                node.xs.pop_back();
+                node.ys.pop_back();
+                node.keys.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <class F>
+    static void queryBucket(const Node &node, double x, double y, double r, F &f)
+    {
+        DistanceKernel::forEachWithin(x, y, node.xs.data(), node.ys.data(), node.keys.size(), r,
+                                      [&node, &f](size_t i)
+                                      { f(node.keys[i]); });
+    }
+
+public:
+    QuadTree(double minX, double minY, double maxX, double maxY)
+        : outside(0, 0, 0, 0, 0)
+    {
+        nodes.emplace_back(minX, minY, maxX, maxY, 0);
+    }
+
+    size_t size() const { return count; }
+
+    void clear()
+    {
+        Node root(nodes[0].minX, nodes[0].minY, nodes[0].maxX, nodes[0].maxY, 0);
+        nodes.clear();
+        nodes.push_back(std::move(root));
+        outside.xs.clear();
+        outside.ys.clear();
+        outside.keys.clear();
+        count = 0;
+    }
+
+    // Добавление точки с ключом key
+    void insert(size_t key, double x, double y)
+    {
+        ++count;
+        if (!nodes[0].contains(x, y))
+        {
+            outside.xs.push_back(x);
+            outside.ys.push_back(y);
+            outside.keys.push_back(key);
+            return;
+        }
+
+        size_t n = findLeaf(x, y);
+        while (nodes[n].keys.size() >= BUCKET_SIZE && nodes[n].depth < MAX_DEPTH)
+        {
+            split(n);
+            n = nodes[n].firstChild + quadrant(nodes[n], x, y);
+        }
+        nodes[n].xs.push_back(x);
+        nodes[n].ys.push_back(y);
+        nodes[n].keys.push_back(key);
+    }
+
+    // Удаление точки; координаты должны совпадать с переданными в insert
+    bool remove(size_t key, double x, double y)
+    {
+        bool removed = nodes[0].contains(x, y) ? eraseFrom(nodes[findLeaf(x, y)], key)
+                                               : eraseFrom(outside, key);
+        if (removed)
+        {
+            --count;
+        }
+        return removed;
+    }
+
+    // Вызов f(key) для всех точек на расстоянии не больше r от (x, y)
+    template <class F>
+    void queryRadius(double x, double y, double r, F &&f) const
+    {
+        if (r < 0)
+            return;
+
+        queryBucket(outside, x, y, r, f);
+
+        std::vector<size_t> stack = {0};
+        while (!stack.empty())
+        {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+            if (!circleIntersects(node, x, y, r))
+                continue;
+
+            if (node.firstChild < 0)
+            {
+                queryBucket(node, x, y, r, f);
+            }
+            else
+            {
+                for (int c = 0; c < 4; ++c)
+                    stack.push_back(node.firstChild + c);
+            }
+        }
+    }
+};
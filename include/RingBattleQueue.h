@@ -0,0 +1,229 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstddef>
+#include <cstdint>
+#include "BattleQueue.h"
+
+// Ограниченная очередь задач для боев на кольцевом буфере без общих
+// блокировок (много производителей / много потребителей, схема Д. Вьюкова).
+// Каждая ячейка хранит счётчик последовательности: по нему производитель
+// и потребитель узнают, свободна ли ячейка.
+// Пакет занимает одним CAS непрерывный диапазон ячеек, которые уже готовы:
+// для производителя — освобождены, для потребителя — записаны. Поэтому после
+// захвата никто не ждёт на отдельной ячейке.
+// Как и в исходной схеме, очередь не lock-free в строгом смысле: производитель,
+// прерванный между захватом и записью, задерживает потребителей следующих
+// за ним ячеек, пока не допишет свои.
+// Мьютекс и condition_variable используются только для сна потребителей,
+// когда в голове очереди нет записанной ячейки, и производителей, когда
+// нет свободной.
+class RingBattleQueue : public BattleTaskQueue
+{
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence{0};
+        BattleTask task{nullptr, nullptr};
+    };
+
+    // Счётчики производителей и потребителей — в разных кеш-линиях
+    struct alignas(64) Position
+    {
+        std::atomic<size_t> value{0};
+    };
+
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    Position enqueuePos;
+    Position dequeuePos;
+
+    std::atomic<bool> stopped{false};
+    std::atomic<int> sleepers{0};
+    std::atomic<uint64_t> droppedCount{0};
+    std::mutex wait_mutex;
+    std::condition_variable cv;
+
+    static size_t roundUpPow2(size_t n)
+    {
+        size_t p = 2;
+        while (p < n)
+            p <<= 1;
+        return p;
+    }
+
+    // Захват до count подряд идущих готовых ячеек одним CAS; first — первая.
+    // Ячейка готова, если её sequence равна позиции + ready: для производителя
+    // ready = 0 (потребитель её освободил), для потребителя ready = 1
+    // (производитель её записал). Менять готовую ячейку может только владелец
+    // её позиции, поэтому после удачного CAS ячейки остаются готовыми.
+    // 0 — первая ячейка не готова (очередь заполнена или пуста).
+    size_t reserve(Position &own, size_t count, size_t ready, size_t &first)
+    {
+        size_t pos = own.value.load(std::memory_order_relaxed);
+        while (true)
+        {
+            size_t k = 0;
+            while (k < count && cells[(pos + k) & mask].sequence.load(std::memory_order_acquire) == pos + k + ready)
+                ++k;
+            if (k == 0)
+            {
+                size_t seq = cells[pos & mask].sequence.load(std::memory_order_acquire);
+                if ((intptr_t)(seq - (pos + ready)) < 0)
+                    return 0;
+                // Ячейку уже забрал другой поток: pos устарел
+                pos = own.value.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (own.value.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed))
+            {
+                first = pos;
+                return k;
+            }
+        }
+    }
+
+    // Готова ли ячейка в голове для производителей (ready = 0) или потребителей (ready = 1)
+    bool headReady(const Position &own, size_t ready) const
+    {
+        size_t pos = own.value.load(std::memory_order_acquire);
+        return cells[pos & mask].sequence.load(std::memory_order_acquire) == pos + ready;
+    }
+
+    // Запись до count задач; возвращает число записанных (0 — свободных ячеек нет)
+    size_t tryPushRange(BattleTask *tasks, size_t count)
+    {
+        size_t first;
+        size_t k = reserve(enqueuePos, count, 0, first);
+        for (size_t i = 0; i < k; ++i)
+        {
+            Cell &cell = cells[(first + i) & mask];
+            cell.task = std::move(tasks[i]);
+            cell.sequence.store(first + i + 1, std::memory_order_release);
+        }
+        return k;
+    }
+
+    // Чтение до maxCount задач; 0 — записанных ячеек нет
+    size_t tryPopRange(BattleTask *out, size_t maxCount)
+    {
+        size_t first;
+        size_t k = reserve(dequeuePos, maxCount, 1, first);
+        for (size_t i = 0; i < k; ++i)
+        {
+            Cell &cell = cells[(first + i) & mask];
+            out[i] = std::move(cell.task);
+            cell.task = BattleTask(nullptr, nullptr);
+            cell.sequence.store(first + i + mask + 1, std::memory_order_release);
+        }
+        return k;
+    }
+
+    // Разбудить спящих, если они есть (иначе — без системных вызовов)
+    void wakeSleepers()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers.load(std::memory_order_relaxed) > 0)
+        {
+            std::lock_guard<std::mutex> lock(wait_mutex);
+            cv.notify_all();
+        }
+    }
+
+    // Ждать, пока pred() не станет истинным. Сначала короткое вращение,
+    // затем сон на condition_variable.
+    template <class Pred>
+    void waitUntil(Pred pred)
+    {
+        for (int spin = 0; spin < 64; ++spin)
+        {
+            if (pred())
+                return;
+            std::this_thread::yield();
+        }
+
+        std::unique_lock<std::mutex> lock(wait_mutex);
+        sleepers.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        cv.wait(lock, pred);
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+public:
+    explicit RingBattleQueue(size_t capacity = 4096, bool coalesce = true)
+        : BattleTaskQueue(coalesce), mask(roundUpPow2(capacity) - 1), cells(new Cell[mask + 1])
+    {
+        for (size_t i = 0; i <= mask; ++i)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    // Задачи, отброшенные из-за переполнения после stop()
+    uint64_t dropped() const { return droppedCount.load(std::memory_order_relaxed); }
+
+protected:
+    size_t pushBatch(BattleTask *tasks, size_t count) override
+    {
+        size_t done = 0;
+        while (done < count)
+        {
+            size_t pushed = tryPushRange(tasks + done, count - done);
+            if (pushed > 0)
+            {
+                done += pushed;
+                wakeSleepers();
+                continue;
+            }
+            if (stopped.load(std::memory_order_acquire))
+            {
+                // Очередь остановлена и заполнена: потребителей может уже не быть
+                droppedCount.fetch_add(count - done, std::memory_order_relaxed);
+                break;
+            }
+            wakeSleepers();
+            waitUntil([this]
+                      { return headReady(enqueuePos, 0) || stopped.load(std::memory_order_acquire); });
+        }
+        return done;
+    }
+
+    size_t popBatch(BattleTask *out, size_t maxCount) override
+    {
+        while (true)
+        {
+            size_t count = tryPopRange(out, maxCount);
+            if (count > 0)
+            {
+                // Освободилось место — разбудим ждущих производителей
+                wakeSleepers();
+                return count;
+            }
+            if (stopped.load(std::memory_order_acquire) && empty())
+            {
+                return 0;
+            }
+            waitUntil([this]
+                      { return headReady(dequeuePos, 1) || stopped.load(std::memory_order_acquire); });
+        }
+    }
+
+public:
+    void stop() override
+    {
+        stopped.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(wait_mutex);
+        cv.notify_all();
+    }
+
+    bool empty() override
+    {
+        return enqueuePos.value.load(std::memory_order_acquire) ==
+               dequeuePos.value.load(std::memory_order_acquire);
+    }
+};
@@ -0,0 +1,212 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <utility>
+#include "DistanceKernel.h"
+
+// Равномерная сетка (spatial hash) для широкой фазы поиска столкновений.
+// Размер ячейки не меньше максимальной дальности убийства, поэтому любая пара
+// NPC на расстоянии убийства лежит в одной ячейке или в соседних.
+// Сетка перестраивается каждый тик сортировкой подсчётом: O(n) по времени,
+// точки одной ячейки лежат в памяти подряд.
+class SpatialHashGrid
+{
+private:
+    double minCellSize;
+    double cellSize = 1.0;
+    double originX = 0.0, originY = 0.0;
+    long cols = 0, rows = 0;
+
+    std::vector<size_t> cellStart; // Начало ячейки в items (cols * rows + 1 элементов)
+    std::vector<size_t> items;     // Индексы точек, упорядоченные по ячейкам
+    std::vector<size_t> cellOf;    // Ячейка каждой точки
+
+    // Координаты и радиусы точек в порядке items — непрерывные блоки для DistanceKernel
+    std::vector<double> sortedX, sortedY, sortedR;
+
+    long cellCoord(double v, double origin) const
+    {
+        return (long)std::floor((v - origin) / cellSize);
+    }
+
+public:
+    explicit SpatialHashGrid(double cellSize) : minCellSize(cellSize > 0 ? cellSize : 1.0) {}
+
+    double getCellSize() const { return cellSize; }
+    size_t getCellCount() const { return (size_t)(cols * rows); }
+
+    // Перестроение сетки по координатам точек.
+    // radii (необязательно) — собственная дальность каждой точки для pairsWithinRange()
+    void build(const std::vector<double> &xs, const std::vector<double> &ys,
+               const std::vector<double> &radii = {})
+    {
+        const size_t n = xs.size();
+        items.resize(n);
+        cellOf.resize(n);
+        sortedX.resize(n);
+        sortedY.resize(n);
+        sortedR.assign(n, 0.0);
+        if (n == 0)
+        {
+            cols = rows = 0;
+            cellStart.assign(1, 0);
+            return;
+        }
+
+        double minX = xs[0], maxX = xs[0], minY = ys[0], maxY = ys[0];
+        for (size_t i = 1; i < n; ++i)
+        {
+            minX = std::min(minX, xs[i]);
+            maxX = std::max(maxX, xs[i]);
+            minY = std::min(minY, ys[i]);
+            maxY = std::max(maxY, ys[i]);
+        }
+
+        // Ограничиваем число ячеек ~4n: для разреженных карт ячейка растёт,
+        // что не нарушает условие «ячейка >= дальности убийства»
+        cellSize = minCellSize;
+        double maxCells = 4.0 * (double)n + 16.0;
+        double w = (maxX - minX) / cellSize + 1.0;
+        double h = (maxY - minY) / cellSize + 1.0;
+        if (w * h > maxCells)
+        {
+            cellSize *= std::sqrt(w * h / maxCells);
+        }
+
+        originX = minX;
+        originY = minY;
+        cols = cellCoord(maxX, originX) + 1;
+        rows = cellCoord(maxY, originY) + 1;
+
+        // Сортировка подсчётом по ячейкам
+        cellStart.assign((size_t)(cols * rows) + 1, 0);
+        for (size_t i = 0; i < n; ++i)
+        {
+            long cx = std::min(cellCoord(xs[i], originX), cols - 1);
+            long cy = std::min(cellCoord(ys[i], originY), rows - 1);
+            cellOf[i] = (size_t)(cy * cols + cx);
+            ++cellStart[cellOf[i] + 1];
+        }
+        for (size_t c = 1; c < cellStart.size(); ++c)
+        {
+            cellStart[c] += cellStart[c - 1];
+        }
+        std::vector<size_t> fill(cellStart.begin(), cellStart.end() - 1);
+        for (size_t i = 0; i < n; ++i)
+        {
+            size_t slot = fill[cellOf[i]]++;
+            items[slot] = i;
+            sortedX[slot] = xs[i];
+            sortedY[slot] = ys[i];
+            if (!radii.empty())
+                sortedR[slot] = radii[i];
+        }
+    }
+
+    // Перебор пар-кандидатов (a < b) из одной или соседних ячеек.
+    // Каждая пара выдаётся ровно один раз: соседи обходятся по половинному
+    // шаблону (восток, юго-запад, юг, юго-восток).
+    template <class F>
+    void forEachCandidatePair(F &&f) const
+    {
+        static const long NEIGHBOURS[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+
+        for (long cy = 0; cy < rows; ++cy)
+        {
+            for (long cx = 0; cx < cols; ++cx)
+            {
+                size_t c = (size_t)(cy * cols + cx);
+                size_t begin = cellStart[c], end = cellStart[c + 1];
+                if (begin == end)
+                    continue;
+
+                // Пары внутри ячейки
+                for (size_t p = begin; p < end; ++p)
+                {
+                    for (size_t q = p + 1; q < end; ++q)
+                    {
+                        f(std::min(items[p], items[q]), std::max(items[p], items[q]));
+                    }
+                }
+
+                // Пары с соседними ячейками
+                for (const auto &d : NEIGHBOURS)
+                {
+                    long nx = cx + d[0], ny = cy + d[1];
+                    if (nx < 0 || nx >= cols || ny >= rows)
+                        continue;
+                    size_t nc = (size_t)(ny * cols + nx);
+                    for (size_t p = begin; p < end; ++p)
+                    {
+                        for (size_t q = cellStart[nc]; q < cellStart[nc + 1]; ++q)
+                        {
+                            f(std::min(items[p], items[q]), std::max(items[p], items[q]));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Пары (a < b) на расстоянии не больше max(radii[a], radii[b]), по возрастанию.
+    // Расстояния проверяются блоками через DistanceKernel: точки ячейки лежат подряд.
+    std::vector<std::pair<size_t, size_t>> pairsWithinRange() const
+    {
+        static const long NEIGHBOURS[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+        std::vector<std::pair<size_t, size_t>> pairs;
+
+        for (long cy = 0; cy < rows; ++cy)
+        {
+            for (long cx = 0; cx < cols; ++cx)
+            {
+                size_t c = (size_t)(cy * cols + cx);
+                size_t begin = cellStart[c], end = cellStart[c + 1];
+
+                for (size_t p = begin; p < end; ++p)
+                {
+                    auto emit = [this, &pairs, p](size_t base)
+                    {
+                        return [this, &pairs, p, base](size_t k)
+                        {
+                            size_t a = items[p], b = items[base + k];
+                            pairs.emplace_back(std::min(a, b), std::max(a, b));
+                        };
+                    };
+
+                    // Остаток своей ячейки
+                    DistanceKernel::forEachWithinRanges(sortedX[p], sortedY[p], sortedR[p],
+                                                        sortedX.data() + p + 1, sortedY.data() + p + 1,
+                                                        sortedR.data() + p + 1, end - p - 1, emit(p + 1));
+
+                    // Соседние ячейки по половинному шаблону
+                    for (const auto &d : NEIGHBOURS)
+                    {
+                        long nx = cx + d[0], ny = cy + d[1];
+                        if (nx < 0 || nx >= cols || ny >= rows)
+                            continue;
+                        size_t nc = (size_t)(ny * cols + nx);
+                        size_t nb = cellStart[nc];
+                        DistanceKernel::forEachWithinRanges(sortedX[p], sortedY[p], sortedR[p],
+                                                            sortedX.data() + nb, sortedY.data() + nb,
+                                                            sortedR.data() + nb, cellStart[nc + 1] - nb, emit(nb));
+                    }
+                }
+            }
+        }
+
+        std::sort(pairs.begin(), pairs.end());
+        return pairs;
+    }
+
+    // Все пары-кандидаты в порядке (a, b) по возрастанию — как при полном переборе
+    std::vector<std::pair<size_t, size_t>> candidatePairs() const
+    {
+        std::vector<std::pair<size_t, size_t>> pairs;
+        forEachCandidatePair([&pairs](size_t a, size_t b)
+                             { pairs.emplace_back(a, b); });
+        std::sort(pairs.begin(), pairs.end());
+        return pairs;
+    }
+};
@@ -0,0 +1,253 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Вывод кадров в терминал по разнице с предыдущим кадром.
+// Кадр рисуется в холст из символов (кодовые точки Unicode); render() сравнивает
+// его с прошлым кадром и собирает в один буфер только изменившиеся участки строк,
+// переходя к ним ANSI-командой позиционирования курсора. present() отправляет
+// буфер одним вызовом write.
+//
+// Первый кадр очищает экран и отводит под холст верхние строки; ниже задаётся
+// область прокрутки, поэтому построчный вывод (боевой лог) не сдвигает карту.
+// Если stdout не терминал, каждый кадр выводится целиком простым текстом;
+// частоту таких кадров ограничивает вызывающий.
+class TerminalRenderer
+{
+private:
+    int rows, cols;
+    std::vector<char32_t> current, previous;
+    std::string buffer;
+    bool ansi;
+    bool started = false;
+
+    // Промежуток из стольких неизменённых клеток дешевле перерисовать, чем перепрыгнуть
+    static constexpr int MAX_GAP = 6;
+
+    static void appendUtf8(std::string &out, char32_t c)
+    {
+        if (c < 0x80)
+        {
+            out += (char)c;
+        }
+        else if (c < 0x800)
+        {
+            out += (char)(0xC0 | (c >> 6));
+            out += (char)(0x80 | (c & 0x3F));
+        }
+        else if (c < 0x10000)
+        {
+            out += (char)(0xE0 | (c >> 12));
+            out += (char)(0x80 | ((c >> 6) & 0x3F));
+            out += (char)(0x80 | (c & 0x3F));
+        }
+        else
+        {
+            out += (char)(0xF0 | (c >> 18));
+            out += (char)(0x80 | ((c >> 12) & 0x3F));
+            out += (char)(0x80 | ((c >> 6) & 0x3F));
+            out += (char)(0x80 | (c & 0x3F));
+        }
+    }
+
+    static void appendMove(std::string &out, int row, int col)
+    {
+        out += "\x1b[";
+        out += std::to_string(row + 1);
+        out += ';';
+        out += std::to_string(col + 1);
+        out += 'H';
+    }
+
+    void appendRow(std::string &out, int row, int from, int to) const
+    {
+        const char32_t *line = current.data() + (size_t)row * cols;
+        for (int col = from; col < to; ++col)
+            appendUtf8(out, line[col]);
+    }
+
+    // Весь холст: очистка экрана, строки, область прокрутки под холстом
+    void buildFull()
+    {
+        if (ansi)
+            buffer += "\x1b[2J\x1b[H";
+        for (int row = 0; row < rows; ++row)
+        {
+            appendRow(buffer, row, 0, cols);
+            buffer += '\n';
+        }
+        if (ansi)
+        {
+            buffer += "\x1b[" + std::to_string(rows + 1) + "r";
+            appendMove(buffer, rows, 0);
+        }
+    }
+
+    // Только изменившиеся участки; курсор области прокрутки сохраняется и восстанавливается
+    void buildDiff()
+    {
+        const size_t header = buffer.size();
+        buffer += "\x1b" "7";
+        bool changed = false;
+        for (int row = 0; row < rows; ++row)
+        {
+            const size_t base = (size_t)row * cols;
+            int col = 0;
+            while (col < cols)
+            {
+                if (current[base + col] == previous[base + col])
+                {
+                    ++col;
+                    continue;
+                }
+                // Участок до следующих MAX_GAP совпадающих клеток подряд
+                int start = col, end = col + 1, same = 0;
+                for (int c = end; c < cols && same < MAX_GAP; ++c)
+                {
+                    if (current[base + c] == previous[base + c])
+                    {
+                        ++same;
+                    }
+                    else
+                    {
+                        same = 0;
+                        end = c + 1;
+                    }
+                }
+                appendMove(buffer, row, start);
+                appendRow(buffer, row, start, end);
+                changed = true;
+                col = end;
+            }
+        }
+        if (changed)
+            buffer += "\x1b" "8";
+        else
+            buffer.resize(header);
+    }
+
+public:
+    TerminalRenderer(int rows, int cols, bool ansi)
+        : rows(rows), cols(cols), current((size_t)rows * cols, U' '), previous(current), ansi(ansi) {}
+
+    // Поддерживает ли stdout ANSI-последовательности (терминал, а не файл или канал)
+    static bool stdoutIsTerminal()
+    {
+#ifdef _WIN32
+        return _isatty(_fileno(stdout)) != 0;
+#else
+        return ::isatty(STDOUT_FILENO) != 0;
+#endif
+    }
+
+    int height() const { return rows; }
+    int width() const { return cols; }
+
+    // Новый кадр: холст заполняется пробелами
+    void clear()
+    {
+        std::fill(current.begin(), current.end(), U' ');
+    }
+
+    void put(int row, int col, char32_t c)
+    {
+        if (row >= 0 && row < rows && col >= 0 && col < cols)
+            current[(size_t)row * cols + col] = c;
+    }
+
+    char32_t at(int row, int col) const
+    {
+        return current[(size_t)row * cols + col];
+    }
+
+    // Строка UTF-8 с позиции (row, col); не вошедшее в ширину холста отбрасывается
+    void text(int row, int col, const std::string &utf8)
+    {
+        for (size_t i = 0; i < utf8.size(); ++col)
+        {
+            unsigned char lead = (unsigned char)utf8[i];
+            size_t length = lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+            char32_t c = length == 1 ? lead : lead & (0x3F >> (length - 1));
+            for (size_t k = 1; k < length && i + k < utf8.size(); ++k)
+                c = (c << 6) | ((unsigned char)utf8[i + k] & 0x3F);
+            put(row, col, c);
+            i += length;
+        }
+    }
+
+    // Байты для вывода кадра; пусто, если кадр не изменился.
+    // Холст запоминается как предыдущий кадр
+    const std::string &render()
+    {
+        buffer.clear();
+        if (!started || !ansi)
+            buildFull();
+        else
+            buildDiff();
+        started = true;
+        previous = current;
+        return buffer;
+    }
+
+    // Вывод собранного кадра одним вызовом write (повтор — только при частичной записи)
+    static void present(const std::string &bytes)
+    {
+        size_t done = 0;
+        while (done < bytes.size())
+        {
+#ifdef _WIN32
+            size_t written = std::fwrite(bytes.data() + done, 1, bytes.size() - done, stdout);
+            std::fflush(stdout);
+            if (written == 0)
+                return;
+#else
+            ssize_t written = ::write(STDOUT_FILENO, bytes.data() + done, bytes.size() - done);
+            if (written <= 0)
+                return;
+#endif
+            done += (size_t)written;
+        }
+    }
+
+    // Снять область прокрутки и поставить курсор под холстом
+    std::string finish() const
+    {
+        if (!ansi || !started)
+            return std::string();
+        return "\x1b[r\x1b[999;1H\n";
+    }
+};
+
+// Ограничение частоты кадров: следующий кадр не раньше чем через 1/fps секунды
+class FrameLimiter
+{
+private:
+    std::chrono::steady_clock::duration interval;
+    std::chrono::steady_clock::time_point next;
+
+public:
+    explicit FrameLimiter(double fps)
+        : interval(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              std::chrono::duration<double>(1.0 / (fps > 0 ? fps : 1.0)))),
+          next(std::chrono::steady_clock::now()) {}
+
+    // Момент, до которого нужно ждать перед следующим кадром
+    std::chrono::steady_clock::time_point nextFrame()
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (next < now)
+            next = now;
+        auto frame = next;
+        next += interval;
+        return frame;
+    }
+};
@@ -0,0 +1,206 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "NPC.h"
+
+// Разбор текстового формата сохранения "Тип Имя X Y" без потоков ввода.
+// Токены режутся по пробелам и табуляциям, числа читаются std::from_chars,
+// имя — string_view в исходный буфер (без выделений памяти на строку).
+// Большой буфер делится по границам строк на части, которые разбираются
+// параллельно; результаты сливаются в порядке файла.
+class TextLoader
+{
+public:
+    // Запись из строки файла; name указывает в исходный буфер
+    struct Record
+    {
+        NPCType type;
+        std::string_view name;
+        double x, y;
+    };
+
+    // Ошибка разбора: номер строки (с 1) и описание
+    struct Error
+    {
+        size_t line = 0;
+        std::string message;
+    };
+
+    // Буферы меньше этого размера разбираются в одном потоке
+    static constexpr size_t PARALLEL_THRESHOLD = 1 << 20;
+
+    // Разбор одной строки. Пустая строка — не ошибка: возвращается true, empty = true
+    static bool parseLine(std::string_view line, Record &out, bool &empty, std::string &message)
+    {
+        std::string_view tokens[4];
+        size_t count = 0;
+        size_t pos = 0;
+        while (true)
+        {
+            while (pos < line.size() && isSpace(line[pos]))
+                ++pos;
+            if (pos >= line.size())
+                break;
+            size_t end = pos;
+            while (end < line.size() && !isSpace(line[end]))
+                ++end;
+            if (count == 4)
+            {
+                message = "лишние данные после координат";
+                return false;
+            }
+            tokens[count++] = line.substr(pos, end - pos);
+            pos = end;
+        }
+
+        empty = count == 0;
+        if (empty)
+            return true;
+        if (count < 4)
+        {
+            message = "ожидается \"Тип Имя X Y\"";
+            return false;
+        }
+        if (!parseType(tokens[0], out.type))
+        {
+            message = "неизвестный тип NPC \"" + std::string(tokens[0]) + "\"";
+            return false;
+        }
+        if (!parseDouble(tokens[2], out.x) || !parseDouble(tokens[3], out.y))
+        {
+            message = "некорректная координата";
+            return false;
+        }
+        out.name = tokens[1];
+        return true;
+    }
+
+    // Разбор буфера целиком. threads = 0 — по числу ядер.
+    // При ошибке возвращает false и заполняет error первой ошибкой в порядке файла.
+    static bool parse(const char *data, size_t size, std::vector<Record> &out, Error &error,
+                      unsigned threads = 0)
+    {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        if (size < PARALLEL_THRESHOLD)
+            threads = 1;
+
+        // Границы частей: сразу после '\n', чтобы строки не разрезались
+        std::vector<size_t> bounds = {0};
+        for (unsigned t = 1; t < threads; ++t)
+        {
+            size_t pos = std::max(bounds.back(), size * t / threads);
+            while (pos < size && data[pos - 1] != '\n')
+                ++pos;
+            if (pos < size)
+                bounds.push_back(pos);
+        }
+        bounds.push_back(size);
+
+        const size_t chunks = bounds.size() - 1;
+        std::vector<Chunk> results(chunks);
+        if (chunks == 1)
+        {
+            parseChunk(data, 0, size, results[0]);
+        }
+        else
+        {
+            std::vector<std::thread> workers;
+            for (size_t c = 0; c < chunks; ++c)
+            {
+                workers.emplace_back([&, c]
+                                     { parseChunk(data, bounds[c], bounds[c + 1], results[c]); });
+            }
+            for (auto &worker : workers)
+                worker.join();
+        }
+
+        // Слияние в порядке файла; номера строк частей сдвигаются на предыдущие
+        size_t total = 0, linesBefore = 0;
+        for (const Chunk &chunk : results)
+        {
+            if (chunk.failed)
+            {
+                error.line = linesBefore + chunk.error.line;
+                error.message = chunk.error.message;
+                return false;
+            }
+            total += chunk.records.size();
+            linesBefore += chunk.lines;
+        }
+
+        out.clear();
+        out.reserve(total);
+        for (Chunk &chunk : results)
+            out.insert(out.end(), chunk.records.begin(), chunk.records.end());
+        return true;
+    }
+
+private:
+    struct Chunk
+    {
+        std::vector<Record> records;
+        size_t lines = 0;
+        bool failed = false;
+        Error error;
+    };
+
+    static bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static bool parseType(std::string_view token, NPCType &type)
+    {
+        for (int t = 0; t < NPC_TYPE_COUNT; ++t)
+        {
+            if (token == npcTypeName((NPCType)t))
+            {
+                type = (NPCType)t;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool parseDouble(std::string_view token, double &value)
+    {
+        const char *begin = token.data(), *end = token.data() + token.size();
+        if (begin != end && *begin == '+')
+            ++begin;
+        auto result = std::from_chars(begin, end, value);
+        return result.ec == std::errc() && result.ptr == end;
+    }
+
+    static void parseChunk(const char *data, size_t begin, size_t end, Chunk &chunk)
+    {
+        chunk.records.reserve((end - begin) / 24);
+        size_t pos = begin;
+        while (pos < end)
+        {
+            const char *newline = static_cast<const char *>(std::memchr(data + pos, '\n', end - pos));
+            size_t lineEnd = newline ? (size_t)(newline - data) : end;
+            ++chunk.lines;
+
+            Record record;
+            bool empty = false;
+            std::string message;
+            if (!parseLine(std::string_view(data + pos, lineEnd - pos), record, empty, message))
+            {
+                chunk.failed = true;
+                chunk.error.line = chunk.lines;
+                chunk.error.message = message;
+                return;
+            }
+            if (!empty)
+                chunk.records.push_back(record);
+            pos = lineEnd + 1;
+        }
+    }
+};
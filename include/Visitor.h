@@ -1,5 +1,6 @@
 #pragma once
 
+class NPC;
 class Knight;
 class Druid;
 class Elf;
@@ -10,6 +11,11 @@ class Visitor
 public:
     virtual ~Visitor() = default;
 
+    // Точка входа из NPC::accept. По умолчанию выбирает перегрузку visitX
+    // по тегам типов участников (без dynamic_cast). Visitor, которому
+    // конкретные типы не нужны, может переопределить этот метод целиком.
+    virtual void visit(NPC &attacker, NPC &defender);
+
     virtual void visitKnight(Knight &attacker, Knight &defender) = 0;
     virtual void visitKnight(Knight &attacker, Druid &defender) = 0;
     virtual void visitKnight(Knight &attacker, Elf &defender) = 0;
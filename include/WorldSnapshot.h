@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "EntityStore.h"
+
+// Неизменяемый снимок мира на конец тика: координаты, типы, имена и флаги
+// жизни живых и мёртвых NPC в плоских массивах (строки как в EntityStore).
+// Читатели (отображение, итоги, метрики) работают со снимком без блокировок
+// симуляции.
+struct WorldSnapshot
+{
+    uint64_t tick = 0;
+    std::vector<double> xs, ys;
+    std::vector<NPCType> types;
+    std::vector<NameId> nameIds;
+    std::vector<uint8_t> alives;
+    size_t aliveCount = 0;
+
+    size_t size() const { return xs.size(); }
+
+    // Копирование столбцов хранилища; буферы переиспользуются без выделений,
+    // если их ёмкости хватает
+    void capture(const EntityStore &store, uint64_t atTick)
+    {
+        const size_t n = store.size();
+        tick = atTick;
+        xs.assign(store.xData().begin(), store.xData().end());
+        ys.assign(store.yData().begin(), store.yData().end());
+        types.resize(n);
+        nameIds.resize(n);
+        alives.resize(n);
+        aliveCount = 0;
+        for (size_t row = 0; row < n; ++row)
+        {
+            types[row] = store.type(row);
+            nameIds[row] = store.nameId(row);
+            alives[row] = store.isAlive(row) ? 1 : 0;
+            aliveCount += alives[row];
+        }
+    }
+};
+
+// Публикация снимков одним писателем для любого числа читателей.
+// latest() и publish() — атомарная замена shared_ptr, без мьютексов симуляции.
+// Двойная буферизация: предыдущий снимок возвращается писателю для
+// перезаписи, как только его не держит ни один читатель.
+class SnapshotPublisher
+{
+private:
+    std::shared_ptr<const WorldSnapshot> current;
+    std::shared_ptr<WorldSnapshot> retired; // Только писатель
+
+public:
+    SnapshotPublisher() : current(std::make_shared<WorldSnapshot>()) {}
+
+    // Последний опубликованный снимок; никогда не nullptr
+    std::shared_ptr<const WorldSnapshot> latest() const
+    {
+        return std::atomic_load(&current);
+    }
+
+    // Буфер для следующего снимка (вызывает только писатель)
+    std::shared_ptr<WorldSnapshot> acquire()
+    {
+        std::shared_ptr<WorldSnapshot> buffer;
+        if (retired && retired.use_count() == 1)
+        {
+            // Старый снимок больше никто не читает — переиспользуем его память.
+            // use_count() читается без упорядочения; барьер связывает его с
+            // освобождением ссылки читателем (release в деструкторе shared_ptr),
+            // так что последние чтения снимка идут раньше его перезаписи
+            std::atomic_thread_fence(std::memory_order_acquire);
+            buffer = std::move(retired);
+        }
+        else
+        {
+            buffer = std::make_shared<WorldSnapshot>();
+        }
+        retired.reset();
+        return buffer;
+    }
+
+    void publish(std::shared_ptr<WorldSnapshot> snapshot)
+    {
+        std::shared_ptr<const WorldSnapshot> previous =
+            std::atomic_exchange(&current, std::shared_ptr<const WorldSnapshot>(snapshot));
+        // const снят только для писателя: снимок уже недоступен новым читателям
+        retired = std::const_pointer_cast<WorldSnapshot>(previous);
+    }
+};
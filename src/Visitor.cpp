@@ -0,0 +1,41 @@
+#include "Visitor.h"
+#include "Knight.h"
+#include "Druid.h"
+#include "Elf.h"
+
+// Выбор перегрузки по тегу типа защищающегося
+template <class Attacker, class Dispatch>
+static void dispatchDefender(Attacker &attacker, NPC &defender, Dispatch dispatch)
+{
+    switch (defender.getTypeTag())
+    {
+    case NPCType::Knight:
+        dispatch(attacker, static_cast<Knight &>(defender));
+        break;
+    case NPCType::Druid:
+        dispatch(attacker, static_cast<Druid &>(defender));
+        break;
+    case NPCType::Elf:
+        dispatch(attacker, static_cast<Elf &>(defender));
+        break;
+    }
+}
+
+void Visitor::visit(NPC &attacker, NPC &defender)
+{
+    switch (attacker.getTypeTag())
+    {
+    case NPCType::Knight:
+        dispatchDefender(static_cast<Knight &>(attacker), defender, [this](Knight &a, auto &d)
+                         { visitKnight(a, d); });
+        break;
+    case NPCType::Druid:
+        dispatchDefender(static_cast<Druid &>(attacker), defender, [this](Druid &a, auto &d)
+                         { visitDruid(a, d); });
+        break;
+    case NPCType::Elf:
+        dispatchDefender(static_cast<Elf &>(attacker), defender, [this](Elf &a, auto &d)
+                         { visitElf(a, d); });
+        break;
+    }
+}
@@ -83,10 +83,11 @@ void addNPCMenu(DungeonEditor &editor)
 void saveToFileMenu(DungeonEditor &editor)
 {
     std::string filename;
-    std::cout << "\nВведите имя файла для сохранения: ";
+    std::cout << "\nВведите имя файла для сохранения (*.bin — двоичный формат): ";
     std::cin >> filename;
 
-    if (editor.saveToFile(filename))
+    bool binary = filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".bin") == 0;
+    if (editor.saveToFile(filename, binary ? SaveFormat::Binary : SaveFormat::Text))
     {
         std::cout << "✓ Данные сохранены в файл " << filename << std::endl;
     }
@@ -109,7 +110,7 @@ void loadFromFileMenu(DungeonEditor &editor)
     }
     else
     {
-        std::cout << "✗ Ошибка загрузки из файла!" << std::endl;
+        std::cout << "✗ Ошибка загрузки из файла: " << editor.getLoadError() << std::endl;
     }
 }
 
@@ -133,17 +134,20 @@ void createTestData(DungeonEditor &editor)
 {
     std::cout << "\n=== Создание тестового набора данных ===" << std::endl;
 
-    // Создаём тестовых персонажей
-    editor.addNPC("Knight", "Артур", 100, 100);
-    editor.addNPC("Knight", "Ланцелот", 150, 120);
-    editor.addNPC("Druid", "Мерлин", 200, 200);
-    editor.addNPC("Druid", "Моргана", 250, 180);
-    editor.addNPC("Elf", "Леголас", 120, 110);
-    editor.addNPC("Elf", "Галадриэль", 300, 300);
-    editor.addNPC("Knight", "Персиваль", 400, 400);
-    editor.addNPC("Druid", "Друид_3", 210, 205);
-
-    std::cout << "✓ Создано 8 тестовых NPC!" << std::endl;
+    // Создаём тестовых персонажей одним пакетом
+    const NPCSpec testNPCs[] = {
+        {"Knight", "Артур", 100, 100},
+        {"Knight", "Ланцелот", 150, 120},
+        {"Druid", "Мерлин", 200, 200},
+        {"Druid", "Моргана", 250, 180},
+        {"Elf", "Леголас", 120, 110},
+        {"Elf", "Галадриэль", 300, 300},
+        {"Knight", "Персиваль", 400, 400},
+        {"Druid", "Друид_3", 210, 205},
+    };
+    size_t created = editor.addNPCs(testNPCs);
+
+    std::cout << "✓ Создано " << created << " тестовых NPC!" << std::endl;
     editor.printNPCs();
 }
 
@@ -1,15 +1,20 @@
 #include <iostream>
 #include <vector>
+#include <string>
 #include <memory>
 #include <thread>
 #include <chrono>
-#include <random>
 #include <algorithm>
 #include <shared_mutex>
 #include <iomanip>
+#include <sstream>
 #include <map>
 #include <cmath>
 #include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
 #include "NPC.h"
 #include "Knight.h"
 #include "Druid.h"
@@ -17,7 +22,19 @@
 #include "NPCFactory.h"
 #include "BattleVisitor.h"
 #include "BattleQueue.h"
+#include "RingBattleQueue.h"
+#include "BattleRounds.h"
 #include "Observer.h"
+#include "AsyncFileObserver.h"
+#include "SpatialHashGrid.h"
+#include "EntityStore.h"
+#include "WorldSnapshot.h"
+#include "CounterRng.h"
+#include "NPCGenerator.h"
+#include "TerminalRenderer.h"
+#include "DensityHeatmap.h"
+#include "Metrics.h"
+#include "MetricsExporter.h"
 // Определяем M_PI если не определено
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -29,213 +46,592 @@ constexpr double MAP_HEIGHT = 100.0;
 constexpr int INITIAL_NPC_COUNT = 50;
 constexpr int GAME_DURATION_SECONDS = 30;
 
+// Способ поиска пар NPC на расстоянии убийства
+enum class CollisionMode
+{
+    BruteForce, // Полный перебор всех пар, O(n^2)
+    Grid        // Равномерная сетка, проверяются только соседние ячейки
+};
+
+// Реализация очереди задач для боев
+enum class QueueKind
+{
+    Mutex, // std::queue под мьютексом
+    Ring   // Кольцевой буфер без общих блокировок
+};
+
+// Настройки игры, задаваемые из командной строки
+struct GameConfig
+{
+    CollisionMode collisionMode = CollisionMode::Grid;
+    // Кольцевая очередь пакетами не обгоняет очередь под мьютексом (BM_BattleQueuePushPop)
+    QueueKind queueKind = QueueKind::Mutex;
+    int battleWorkers = 1; // Число потоков боёв
+    uint64_t seed = BattleVisitor::randomSeed(); // Ключ всех случайных чисел игры
+    int npcCount = INITIAL_NPC_COUNT;
+    bool headless = false; // Без сна и отрисовки: фиксированное число тиков подряд
+    uint64_t ticks = 300;  // Число тиков в режиме headless
+    NPCAllocation allocation = NPCAllocation::Pool; // Память под объекты NPC
+    double fps = 10.0;     // Предел частоты кадров карты
+    bool heatmapView = false; // Вместо карты — карта плотности
+    int heatmapCols = 64, heatmapRows = 32;
+    std::string heatmapOut;    // Файл PGM/PPM карты плотности; пусто — не писать
+    uint64_t heatmapEvery = 10; // Период записи карты плотности в тиках
+    std::string metricsOut; // Файл метрик Prometheus; пусто — не писать
+    int metricsPort = -1;   // Порт HTTP-выгрузки метрик на 127.0.0.1; -1 — выключена
+    int metricsEveryMs = 1000; // Период записи файла метрик
+};
+
+// Размер пакета задач, забираемых потоком боев за раз
+constexpr size_t BATTLE_BATCH_SIZE = 64;
+
+// Сколько погибших NPC удаляется из мира за тик
+constexpr size_t COMPACT_ROWS_PER_TICK = 4096;
+
+// Частота полных кадров, когда stdout не терминал (файл, канал): раз в секунду
+constexpr double PLAIN_FPS = 1.0;
+
+// Размер кадра карты в символах: заголовок, счётчики, карта 50x50 в рамке, легенда
+constexpr int FRAME_ROWS = 3 + (int)(MAP_HEIGHT / 2) + 2;
+constexpr int FRAME_COLS = 2 + (int)(MAP_WIDTH / 2) + 2 + 2;
+
+// Символ NPC на карте
+static char typeSymbol(NPCType type)
+{
+    switch (type)
+    {
+    case NPCType::Knight:
+        return 'K';
+    case NPCType::Druid:
+        return 'D';
+    case NPCType::Elf:
+        return 'E';
+    }
+    return '?';
+}
+
 // Класс для управления игрой
 class Game
 {
 private:
-    std::vector<std::shared_ptr<NPC>> npcs;
+    // NPC в виде структуры массивов; пишет только поток движения
+    EntityStore world;
     mutable std::shared_mutex npcs_mutex; // Используем shared_mutex для чтения/записи
-    BattleQueue battleQueue;
+    std::unique_ptr<BattleTaskQueue> battleQueue;
+    // Задачи текущего тика; отправляются в очередь раундами без общих NPC
+    std::vector<BattleTask> pendingBattles;
+    BattleRounds battleRounds;
+    // Размер пакета потока боёв: раунд делится между всеми потоками
+    std::atomic<size_t> battleBatch{BATTLE_BATCH_SIZE};
+    // Номер текущего тика движения (эпоха задач боёв)
+    uint64_t tick = 0;
     Subject subject;
+    // Журнал боёв: запись в файл идёт в фоновом потоке
+    std::shared_ptr<AsyncFileObserver> battleLog;
     std::atomic<bool> game_running{true};
+    GameConfig config;
+
+    // Конец раунда: поток боёв будит поток движения, разобрав последнюю задачу
+    std::mutex battles_mutex;
+    std::condition_variable battlesDone;
+
+    // Сетка для широкой фазы поиска столкновений
+    SpatialHashGrid grid;
+
+    // Снимки мира для отображения и итогов: читаются без блокировок симуляции
+    SnapshotPublisher snapshots;
+
+    // Задачи, разобранные потоками боёв, и бои, в которых оба участника были живы
+    std::atomic<uint64_t> battlesHandled{0};
+    std::atomic<uint64_t> battlesFought{0};
+
+    // Метрики симуляции в общем реестре программы
+    Histogram &tickSeconds;
+    Histogram &lockWaitSeconds;
+    Histogram &lockHoldSeconds;
+    Counter &ticksTotal;
+    Counter &battleTasksFound;
+    Counter &battlesTotal;
+    Gauge &npcsAlive;
+
+    // Максимальная дальность убийства среди всех типов NPC
+    static double maxKillRange()
+    {
+        return std::max({Knight("", 0, 0).getKillRange(),
+                         Druid("", 0, 0).getKillRange(),
+                         Elf("", 0, 0).getKillRange()});
+    }
+
+    void pushBattle(size_t i, size_t j)
+    {
+        pendingBattles.emplace_back(&world.object(i), &world.object(j),
+                                    world.handleAt(i), world.handleAt(j), tick);
+    }
+
+    // Очередь без объединения пар: раунды тика разбираются до постановки
+    // следующего, поэтому пара не может ещё ждать в очереди
+    static std::unique_ptr<BattleTaskQueue> makeQueue(QueueKind kind)
+    {
+        if (kind == QueueKind::Ring)
+            return std::make_unique<RingBattleQueue>(4096, false);
+        return std::make_unique<BattleQueue>(false);
+    }
+
+    // Поиск боёв полным перебором всех пар живых NPC
+    void detectCollisionsBruteForce()
+    {
+        const std::vector<uint32_t> &live = world.liveRows();
+        for (size_t a = 0; a < live.size(); ++a)
+        {
+            const size_t i = live[a];
+            for (size_t b = a + 1; b < live.size(); ++b)
+            {
+                const size_t j = live[b];
+                double dx = world.x(i) - world.x(j);
+                double dy = world.y(i) - world.y(j);
+                double distance = std::sqrt(dx * dx + dy * dy);
+                int killRange = std::max(world.killRange(i), world.killRange(j));
 
-    // Генератор случайных чисел
-    std::mt19937 rng;
+                if (distance <= killRange)
+                {
+                    // Создаем задачу для боя
+                    pushBattle(i, j);
+                }
+            }
+        }
+    }
+
+    // Поиск боёв через сетку: пары проверяются только из соседних ячеек,
+    // расстояния — пакетно через DistanceKernel. Задачи создаются
+    // в том же порядке, что и при полном переборе (по списку живых).
+    void detectCollisionsGrid()
+    {
+        const std::vector<uint32_t> &live = world.liveRows();
+        std::vector<size_t> index;
+        std::vector<double> xs, ys, ranges;
+        index.reserve(live.size());
+        xs.reserve(live.size());
+        ys.reserve(live.size());
+        ranges.reserve(live.size());
+
+        for (size_t i : live)
+        {
+            index.push_back(i);
+            xs.push_back(world.x(i));
+            ys.push_back(world.y(i));
+            ranges.push_back(world.killRange(i));
+        }
+
+        grid.build(xs, ys, ranges);
+        for (const auto &pair : grid.pairsWithinRange())
+        {
+            pushBattle(index[pair.first], index[pair.second]);
+        }
+    }
 
 public:
-    Game() : rng(std::random_device{}())
+    explicit Game(const GameConfig &config = GameConfig())
+        : battleQueue(makeQueue(config.queueKind)), config(config),
+          grid(maxKillRange()),
+          tickSeconds(MetricsRegistry::global().histogram("dungeon_tick_seconds", "Длительность тика движения, с")),
+          lockWaitSeconds(MetricsRegistry::global().histogram("dungeon_world_lock_wait_seconds",
+                                                              "Ожидание npcs_mutex потоком движения, с")),
+          lockHoldSeconds(MetricsRegistry::global().histogram("dungeon_world_lock_hold_seconds",
+                                                              "Удержание npcs_mutex потоком движения, с")),
+          ticksTotal(MetricsRegistry::global().counter("dungeon_ticks_total", "Тики движения")),
+          battleTasksFound(MetricsRegistry::global().counter("dungeon_battle_tasks_found_total",
+                                                             "Пары на дальности боя, найденные за тики")),
+          battlesTotal(MetricsRegistry::global().counter("dungeon_battles_total", "Бои, в которых оба участника были живы")),
+          npcsAlive(MetricsRegistry::global().gauge("dungeon_npcs_alive", "Живые NPC на конец тика"))
     {
-        // Добавляем наблюдателей
-        subject.attach(std::make_shared<ConsoleObserver>());
-        subject.attach(std::make_shared<FileObserver>("battle_log.txt"));
+        // Добавляем наблюдателей; без отрисовки журнал боёв пишется только в файл
+        if (!config.headless)
+            subject.attach(std::make_shared<ConsoleObserver>());
+        battleLog = std::make_shared<AsyncFileObserver>("battle_log.txt");
+        subject.attach(battleLog);
+        NPCFactory::setAllocation(config.allocation);
     }
 
-    // Генерация случайных NPC
+    // Генерация случайных NPC: объекты создаются параллельно вне блокировки,
+    // в мир добавляются и публикуются одним пакетом
     void generateRandomNPCs(int count)
     {
-        std::uniform_real_distribution<double> pos_dist(0.0, MAP_WIDTH);
-        std::uniform_int_distribution<int> type_dist(0, 2);
+        auto start = std::chrono::steady_clock::now();
+        auto generated = NPCGenerator::generate(config.seed, (size_t)count, MAP_WIDTH, MAP_HEIGHT);
 
-        std::vector<std::string> types = {"Knight", "Druid", "Elf"};
+        std::unique_lock<std::shared_mutex> lock(npcs_mutex);
+        world.reserve(world.size() + generated.size());
+        for (const auto &npc : generated)
+        {
+            world.add(npc);
+        }
+        publishSnapshot();
+        lock.unlock();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::lock_guard<std::mutex> cout_lock(cout_mutex);
+        std::cout << "Создано " << count << " NPC на карте " << MAP_WIDTH << "x" << MAP_HEIGHT
+                  << " (seed " << config.seed << ") за " << std::fixed << std::setprecision(2)
+                  << seconds << " с" << std::defaultfloat << std::endl;
+    }
 
-        for (int i = 0; i < count; ++i)
+    // Порционное удаление погибших из мира. Задачи боёв держат обычные указатели
+    // на NPC, поэтому строки удаляются только когда все поставленные задачи
+    // разобраны; новые задачи ставит только этот же поток после удаления.
+    void removeDead()
+    {
+        if (battlesHandled.load(std::memory_order_acquire) < battleQueue->stats().enqueued)
+            return;
+        world.compactStep(COMPACT_ROWS_PER_TICK);
+    }
+
+    // Один тик симуляции: смерти, движение, поиск боёв, снимок, отправка задач
+    void step()
+    {
+        ScopedTimer tickTimer(tickSeconds);
+        auto lockRequested = std::chrono::steady_clock::now();
         {
-            double x = pos_dist(rng);
-            double y = pos_dist(rng);
-            std::string type = types[type_dist(rng)];
-            std::string name = type + "_" + std::to_string(i + 1);
+            std::unique_lock<std::shared_mutex> lock(npcs_mutex);
+            auto lockAcquired = std::chrono::steady_clock::now();
+            lockWaitSeconds.observe(std::chrono::duration<double>(lockAcquired - lockRequested).count());
 
-            auto npc = NPCFactory::createNPC(type, name, x, y);
-            if (npc)
+            // Учитываем смерти, зафиксированные потоком боёв
+            world.applyDeaths();
+            removeDead();
+
+            // Перемещаем живых NPC
+            for (size_t i : world.liveRows())
             {
-                std::unique_lock<std::shared_mutex> lock(npcs_mutex);
-                npcs.push_back(npc);
+                // Направление — функция от (seed, тик, дескриптор), без общего состояния
+                double angle = 2 * M_PI * CounterRng::uniform(config.seed, tick, world.handleAt(i));
+                int moveRange = world.moveRange(i);
+                double dx = std::cos(angle) * moveRange;
+                double dy = std::sin(angle) * moveRange;
+
+                world.move(i, dx, dy, MAP_WIDTH, MAP_HEIGHT);
             }
+
+            // Проверяем столкновения и создаем задачи для боев
+            if (config.collisionMode == CollisionMode::Grid)
+                detectCollisionsGrid();
+            else
+                detectCollisionsBruteForce();
+
+            publishSnapshot();
+            npcsAlive.set((int64_t)world.liveCount());
+            lockHoldSeconds.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - lockAcquired).count());
         }
 
-        std::lock_guard<std::mutex> lock(cout_mutex);
-        std::cout << "Создано " << count << " NPC на карте " << MAP_WIDTH << "x" << MAP_HEIGHT << std::endl;
+        battleTasksFound.add(pendingBattles.size());
+        // Следующий раунд ставится, когда потоки боёв разобрали предыдущий:
+        // исход тика не зависит от числа потоков (см. BattleRounds)
+        battleRounds.plan(pendingBattles);
+        for (size_t r = 0; r < battleRounds.rounds(); ++r)
+        {
+            size_t size = battleRounds.roundSize(r);
+            size_t workers = (size_t)config.battleWorkers;
+            size_t share = (size + workers - 1) / workers;
+            battleBatch.store(std::min(share, BATTLE_BATCH_SIZE), std::memory_order_relaxed);
+            battleQueue->push_n(battleRounds.round(r), size);
+            waitForBattles();
+        }
+        ++tick;
+        ticksTotal.add();
     }
 
     // Поток движения NPC и обнаружения боев
     void movementThread()
     {
-        std::uniform_real_distribution<double> angle_dist(0.0, 2 * M_PI);
-
         while (game_running)
         {
-            {
-                std::shared_lock<std::shared_mutex> lock(npcs_mutex);
+            step();
 
-                // Перемещаем живых NPC
-                for (auto &npc : npcs)
-                {
-                    if (!npc->isAlive())
-                        continue;
+            // Спим немного, чтобы не загружать процессор
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
 
-                    // Генерируем случайное направление
-                    double angle = angle_dist(rng);
-                    int moveRange = npc->getMoveRange();
-                    double dx = std::cos(angle) * moveRange;
-                    double dy = std::sin(angle) * moveRange;
+    // Все принятые очередью задачи разобраны
+    bool battlesDrained() const
+    {
+        return battlesHandled.load(std::memory_order_acquire) >= battleQueue->stats().enqueued;
+    }
 
-                    npc->move(dx, dy, MAP_WIDTH, MAP_HEIGHT);
-                }
+    // Ожидание, пока потоки боёв не разберут все принятые очередью задачи;
+    // после остановки игры потоки боёв могут уже завершиться — не ждём
+    void waitForBattles()
+    {
+        std::unique_lock<std::mutex> lock(battles_mutex);
+        battlesDone.wait(lock, [this]
+                         { return battlesDrained() || !game_running; });
+    }
 
-                // Проверяем столкновения и создаем задачи для боев
-                for (size_t i = 0; i < npcs.size(); ++i)
-                {
-                    if (!npcs[i]->isAlive())
-                        continue;
-
-                    for (size_t j = i + 1; j < npcs.size(); ++j)
-                    {
-                        if (!npcs[j]->isAlive())
-                            continue;
-
-                        double distance = npcs[i]->distanceTo(*npcs[j]);
-                        int killRange = std::max(npcs[i]->getKillRange(), npcs[j]->getKillRange());
-
-                        if (distance <= killRange)
-                        {
-                            // Создаем задачу для боя
-                            battleQueue.push(BattleTask(npcs[i], npcs[j]));
-                        }
-                    }
-                }
-            }
+    // Разбудить waitForBattles; мьютекс берётся, чтобы пробуждение не потерялось
+    // между проверкой условия и началом ожидания
+    void signalBattles()
+    {
+        {
+            std::lock_guard<std::mutex> lock(battles_mutex);
+        }
+        battlesDone.notify_all();
+    }
 
-            // Спим немного, чтобы не загружать процессор
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // Остановка потоков игры: ожидание раунда прерывается, очередь будит потоки боёв
+    void stopGame()
+    {
+        game_running = false;
+        signalBattles();
+        battleQueue->stop();
+    }
+
+    // Публикация снимка мира на конец тика; вызывается под блокировкой мира
+    void publishSnapshot()
+    {
+        std::shared_ptr<WorldSnapshot> snapshot = snapshots.acquire();
+        snapshot->capture(world, tick);
+        snapshots.publish(std::move(snapshot));
+    }
+
+    // Бой по задаче раунда; других боёв с её участниками сейчас нет
+    void resolveBattle(BattleVisitor &battleVisitor, const BattleTask &task)
+    {
+        // Проверяем, что оба NPC еще живы
+        if (task.attacker->isAlive() && task.defender->isAlive())
+        {
+            battleVisitor.setBattleContext(task.epoch,
+                                           BattleVisitor::pairKey(task.attackerHandle, task.defenderHandle));
+            // Используем паттерн Visitor для боя
+            task.attacker->accept(battleVisitor, *task.defender);
+
+            // Сообщаем хранилищу о погибших
+            if (!task.attacker->isAlive())
+                world.reportDeath(task.attackerHandle);
+            if (!task.defender->isAlive())
+                world.reportDeath(task.defenderHandle);
+            battlesFought.fetch_add(1, std::memory_order_relaxed);
+            battlesTotal.add();
         }
     }
 
-    // Поток боев
+    // Поток боев. Несколько таких потоков забирают задачи пакетами.
+    // В очереди одновременно стоит один раунд BattleRounds, а у задач раунда
+    // нет общих NPC, поэтому бои идут без захватов и блокировок NPC.
+    // Поток, разобравший последнюю задачу раунда, будит поток движения.
     void battleThread()
     {
-        BattleVisitor battleVisitor(subject);
+        BattleVisitor battleVisitor(subject, config.seed);
+
+        std::vector<BattleTask> batch(BATTLE_BATCH_SIZE, BattleTask(nullptr, nullptr));
 
-        while (game_running || !battleQueue.empty())
+        while (game_running || !battleQueue->empty())
         {
-            BattleTask task(nullptr, nullptr);
-            if (battleQueue.pop(task))
+            size_t count = battleQueue->pop_n(batch.data(), battleBatch.load(std::memory_order_relaxed));
+            for (size_t k = 0; k < count; ++k)
             {
-                // Проверяем, что оба NPC еще живы
-                if (task.attacker && task.defender &&
-                    task.attacker->isAlive() && task.defender->isAlive())
-                {
-                    // Используем паттерн Visitor для боя
-                    task.attacker->accept(battleVisitor, *task.defender);
-                }
+                BattleTask &task = batch[k];
+                if (task.attacker && task.defender)
+                    resolveBattle(battleVisitor, task);
+                task = BattleTask(nullptr, nullptr);
             }
+            if (count == 0)
+                continue;
+            battlesHandled.fetch_add(count, std::memory_order_release);
+            if (battlesDrained())
+                signalBattles();
         }
     }
 
-    // Поток вывода карты
-    void displayThread()
+    // Кадр карты на холсте: заголовок, счётчики, карта 50x50 в рамке, легенда
+    static void drawFrame(TerminalRenderer &canvas, const WorldSnapshot &snapshot)
     {
-        int iteration = 0;
-        while (game_running)
-        {
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+        // Масштаб: 2 единицы = 1 символ
+        const int SCALE = 2;
+        const int MAP_COLS = (int)(MAP_WIDTH / SCALE);
+        const int MAP_ROWS = (int)(MAP_HEIGHT / SCALE);
+        const int TOP = 3; // Первая строка карты
 
-            std::shared_lock<std::shared_mutex> lock(npcs_mutex);
-            std::lock_guard<std::mutex> cout_lock(cout_mutex);
+        canvas.clear();
 
-            std::cout << "\n╔════════════════════════════════════════════════╗" << std::endl;
-            std::cout << "║  КАРТА " << MAP_WIDTH << "x" << MAP_HEIGHT << " (Итерация " << std::setw(2) << ++iteration << ")              ║" << std::endl;
-            std::cout << "╚════════════════════════════════════════════════╝" << std::endl;
+        int type_counts[NPC_TYPE_COUNT] = {};
+        for (size_t i = 0; i < snapshot.size(); ++i)
+        {
+            if (snapshot.alives[i])
+                type_counts[(int)snapshot.types[i]]++;
+        }
+
+        std::ostringstream title, status;
+        title << "КАРТА " << MAP_WIDTH << "x" << MAP_HEIGHT << " (тик " << snapshot.tick << ")";
+        status << "Живых: " << snapshot.aliveCount << " | K:" << type_counts[(int)NPCType::Knight]
+               << " D:" << type_counts[(int)NPCType::Druid] << " E:" << type_counts[(int)NPCType::Elf];
+        canvas.text(0, 2, title.str());
+        canvas.text(1, 2, status.str());
+
+        // Рамка и пустые клетки
+        canvas.text(TOP - 1, 2, "+" + std::string(MAP_COLS, '-') + "+");
+        canvas.text(TOP + MAP_ROWS, 2, "+" + std::string(MAP_COLS, '-') + "+");
+        for (int row = 0; row < MAP_ROWS; ++row)
+        {
+            canvas.put(TOP + row, 2, U'|');
+            canvas.put(TOP + row, 3 + MAP_COLS, U'|');
+            for (int col = 0; col < MAP_COLS; ++col)
+                canvas.put(TOP + row, 3 + col, U'.');
+        }
 
-            // Подсчет живых NPC
-            int alive_count = 0;
-            std::map<std::string, int> type_counts;
+        // Размещаем NPC на карте; если в клетке уже есть NPC, показываем *
+        for (size_t i = 0; i < snapshot.size(); ++i)
+        {
+            if (!snapshot.alives[i])
+                continue;
 
-            for (const auto &npc : npcs)
+            int x = (int)(snapshot.xs[i] / SCALE);
+            int y = (int)(snapshot.ys[i] / SCALE);
+            if (x >= 0 && x < MAP_COLS && y >= 0 && y < MAP_ROWS)
             {
-                if (npc->isAlive())
-                {
-                    alive_count++;
-                    type_counts[npc->getType()]++;
-                }
+                int row = TOP + y, col = 3 + x;
+                canvas.put(row, col, canvas.at(row, col) == U'.' ? (char32_t)typeSymbol(snapshot.types[i]) : U'*');
             }
+        }
+        canvas.text(TOP + MAP_ROWS + 1, 2, "Легенда: K=Knight, D=Druid, E=Elf, *=несколько NPC");
+    }
 
-            std::cout << "Живых: " << alive_count << " | K:" << type_counts["Knight"]
-                      << " D:" << type_counts["Druid"] << " E:" << type_counts["Elf"] << std::endl;
+    // Кадр карты плотности: число NPC в клетке показано заливкой
+    static void drawHeatmapFrame(TerminalRenderer &canvas, const DensityHeatmap &heatmap, const WorldSnapshot &snapshot)
+    {
+        const int TOP = 3;
+        const int COLS = heatmap.columns(), ROWS = heatmap.lines();
+
+        canvas.clear();
+        std::ostringstream title, status, legend;
+        title << "ПЛОТНОСТЬ " << MAP_WIDTH << "x" << MAP_HEIGHT << " -> " << COLS << "x" << ROWS
+              << " (тик " << snapshot.tick << ")";
+        status << "Живых: " << snapshot.aliveCount << " | K:" << heatmap.typeTotal(NPCType::Knight)
+               << " D:" << heatmap.typeTotal(NPCType::Druid) << " E:" << heatmap.typeTotal(NPCType::Elf);
+        legend << "Заливка \"" << DensityHeatmap::SHADES << "\": до " << heatmap.maxCellTotal() << " NPC в клетке";
+        canvas.text(0, 2, title.str());
+        canvas.text(1, 2, status.str());
+
+        canvas.text(TOP - 1, 2, "+" + std::string(COLS, '-') + "+");
+        canvas.text(TOP + ROWS, 2, "+" + std::string(COLS, '-') + "+");
+        for (int row = 0; row < ROWS; ++row)
+        {
+            canvas.put(TOP + row, 2, U'|');
+            canvas.put(TOP + row, 3 + COLS, U'|');
+        }
+        heatmap.draw(canvas, TOP, 3);
+        canvas.text(TOP + ROWS + 1, 2, legend.str());
+    }
 
-            // Рисуем карту 100x100 (масштаб: 2 единицы = 1 символ, итого 50x50 символов)
-            const int SCALE = 2;
-            const int MAP_COLS = (int)(MAP_WIDTH / SCALE);
-            const int MAP_ROWS = (int)(MAP_HEIGHT / SCALE);
+    // Запись карты плотности в файл: номер тика вставляется перед расширением
+    void writeHeatmap(const DensityHeatmap &heatmap, uint64_t atTick) const
+    {
+        std::string filename = config.heatmapOut;
+        size_t dot = filename.find_last_of('.');
+        size_t slash = filename.find_last_of("/\\");
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+            dot = filename.size();
+        std::ostringstream suffix;
+        suffix << "_" << std::setw(6) << std::setfill('0') << atTick;
+        filename.insert(dot, suffix.str());
+
+        if (!heatmap.write(filename))
+        {
+            std::lock_guard<std::mutex> cout_lock(cout_mutex);
+            std::cerr << "Не удалось записать карту плотности в " << filename << std::endl;
+        }
+    }
 
-            std::vector<std::vector<char>> grid(MAP_ROWS, std::vector<char>(MAP_COLS, '.'));
+    // Подсчёт и запись карты плотности раз в config.heatmapEvery тиков;
+    // lastPeriod — номер периода последней записи
+    void maybeWriteHeatmap(DensityHeatmap &heatmap, const WorldSnapshot &snapshot, uint64_t &lastPeriod, bool built)
+    {
+        if (config.heatmapOut.empty())
+            return;
+        uint64_t period = snapshot.tick / config.heatmapEvery;
+        if (period == lastPeriod)
+            return;
+        lastPeriod = period;
+        if (!built)
+            heatmap.build(snapshot);
+        writeHeatmap(heatmap, snapshot.tick);
+    }
 
-            // Размещаем NPC на карте
-            for (const auto &npc : npcs)
-            {
-                if (!npc->isAlive())
-                    continue;
+    // Поток вывода карты. Кадр собирается из последнего снимка без блокировок
+    // мира; в консоль уходят только изменившиеся клетки одним вызовом write,
+    // не чаще config.fps раз в секунду и только для нового тика.
+    void displayThread()
+    {
+        DensityHeatmap heatmap(config.heatmapCols, config.heatmapRows, MAP_WIDTH, MAP_HEIGHT);
+        const int rows = config.heatmapView ? config.heatmapRows + 5 : FRAME_ROWS;
+        const int cols = config.heatmapView ? std::max(FRAME_COLS, config.heatmapCols + 6) : FRAME_COLS;
+        const bool ansi = TerminalRenderer::stdoutIsTerminal();
+        TerminalRenderer canvas(rows, cols, ansi);
+        // Без терминала каждый кадр печатается целиком — не чаще раза в секунду
+        FrameLimiter limiter(ansi ? config.fps : std::min(config.fps, PLAIN_FPS));
+        uint64_t shownTick = UINT64_MAX;
+        uint64_t writtenPeriod = UINT64_MAX;
 
-                int x = (int)(npc->getX() / SCALE);
-                int y = (int)(npc->getY() / SCALE);
+        while (game_running)
+        {
+            std::this_thread::sleep_until(limiter.nextFrame());
 
-                // Проверка границ
-                if (x >= 0 && x < MAP_COLS && y >= 0 && y < MAP_ROWS)
-                {
-                    char symbol = '?';
-                    if (npc->getType() == "Knight")
-                        symbol = 'K';
-                    else if (npc->getType() == "Druid")
-                        symbol = 'D';
-                    else if (npc->getType() == "Elf")
-                        symbol = 'E';
-
-                    // Если в клетке уже есть NPC, показываем *
-                    if (grid[y][x] != '.')
-                        grid[y][x] = '*';
-                    else
-                        grid[y][x] = symbol;
-                }
-            }
+            std::shared_ptr<const WorldSnapshot> snapshot = snapshots.latest();
+            if (snapshot->tick == shownTick)
+                continue;
+            shownTick = snapshot->tick;
 
-            // Выводим карту с рамкой
-            std::cout << "  +" << std::string(MAP_COLS, '-') << "+" << std::endl;
-            for (int row = 0; row < MAP_ROWS; ++row)
+            if (config.heatmapView)
             {
-                std::cout << "  |";
-                for (int col = 0; col < MAP_COLS; ++col)
-                {
-                    std::cout << grid[row][col];
-                }
-                std::cout << "|" << std::endl;
+                heatmap.build(*snapshot);
+                drawHeatmapFrame(canvas, heatmap, *snapshot);
+            }
+            else
+            {
+                drawFrame(canvas, *snapshot);
             }
-            std::cout << "  +" << std::string(MAP_COLS, '-') << "+" << std::endl;
-            std::cout << "  Легенда: K=Knight, D=Druid, E=Elf, *=несколько NPC" << std::endl;
+            maybeWriteHeatmap(heatmap, *snapshot, writtenPeriod, config.heatmapView);
+            const std::string &bytes = canvas.render();
+            if (bytes.empty())
+                continue;
+
+            // Консоль занята только на время одной записи готового кадра
+            std::lock_guard<std::mutex> cout_lock(cout_mutex);
+            std::cout.flush();
+            TerminalRenderer::present(bytes);
         }
+
+        std::lock_guard<std::mutex> cout_lock(cout_mutex);
+        std::cout.flush();
+        TerminalRenderer::present(canvas.finish());
+    }
+
+    // Выгрузка метрик в файл и/или по HTTP; nullptr, если выгрузка не задана
+    std::unique_ptr<MetricsExporter> startMetricsExport() const
+    {
+        if (config.metricsOut.empty() && config.metricsPort < 0)
+            return nullptr;
+        auto exporter = std::make_unique<MetricsExporter>(MetricsRegistry::global(), config.metricsOut,
+                                                          config.metricsPort,
+                                                          std::chrono::milliseconds(config.metricsEveryMs));
+        if (!exporter->start())
+            throw std::runtime_error("Не удалось открыть порт метрик " + std::to_string(config.metricsPort));
+        if (config.metricsPort >= 0)
+        {
+            std::lock_guard<std::mutex> cout_lock(cout_mutex);
+            std::cout << "Метрики: http://127.0.0.1:" << exporter->port() << "/metrics" << std::endl;
+        }
+        return exporter;
     }
 
     // Запуск игры
     void run()
     {
+        if (config.headless)
+        {
+            runHeadless();
+            return;
+        }
+        std::unique_ptr<MetricsExporter> metricsExport = startMetricsExport();
+
         {
             std::lock_guard<std::mutex> lock(cout_mutex);
             std::cout << "\n╔════════════════════════════════════════════════╗" << std::endl;
@@ -247,29 +643,136 @@ public:
 
         // Запускаем потоки
         std::thread movement_thread(&Game::movementThread, this);
-        std::thread battle_thread(&Game::battleThread, this);
+        std::vector<std::thread> battle_threads;
+        for (int i = 0; i < config.battleWorkers; ++i)
+        {
+            battle_threads.emplace_back(&Game::battleThread, this);
+        }
         std::thread display_thread(&Game::displayThread, this);
 
         // Ждем завершения игры
         std::this_thread::sleep_for(std::chrono::seconds(GAME_DURATION_SECONDS));
 
         // Останавливаем игру
-        game_running = false;
-        battleQueue.stop();
+        stopGame();
 
         // Ждем завершения всех потоков
         movement_thread.join();
-        battle_thread.join();
+        for (auto &thread : battle_threads)
+        {
+            thread.join();
+        }
         display_thread.join();
 
+        // Применяем последние смерти и переносим координаты в объекты NPC
+        {
+            std::unique_lock<std::shared_mutex> lock(npcs_mutex);
+            world.applyDeaths();
+            world.syncObjects();
+            publishSnapshot();
+        }
+
         // Выводим список выживших
         printSurvivors();
+        printQueueStats();
+        printLogStats();
+    }
+
+    // Режим без отрисовки: config.ticks тиков подряд без сна.
+    // Каждый тик завершается, когда потоки боёв разобрали все его задачи,
+    // поэтому с заданным seed прогон воспроизводим при любом числе потоков боёв.
+    void runHeadless()
+    {
+        std::unique_ptr<MetricsExporter> metricsExport = startMetricsExport();
+
+        std::vector<std::thread> battle_threads;
+        for (int i = 0; i < config.battleWorkers; ++i)
+        {
+            battle_threads.emplace_back(&Game::battleThread, this);
+        }
+
+        DensityHeatmap heatmap(config.heatmapCols, config.heatmapRows, MAP_WIDTH, MAP_HEIGHT);
+        uint64_t writtenPeriod = UINT64_MAX;
+        std::chrono::steady_clock::duration heatmapTime{0};
+        uint64_t heatmapFrames = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t t = 0; t < config.ticks; ++t)
+        {
+            step();
+
+            if (!config.heatmapOut.empty())
+            {
+                auto heatmapStart = std::chrono::steady_clock::now();
+                uint64_t before = writtenPeriod;
+                maybeWriteHeatmap(heatmap, *snapshots.latest(), writtenPeriod, false);
+                if (writtenPeriod != before)
+                {
+                    heatmapTime += std::chrono::steady_clock::now() - heatmapStart;
+                    ++heatmapFrames;
+                }
+            }
+        }
+        auto finish = std::chrono::steady_clock::now();
+
+        stopGame();
+        for (auto &thread : battle_threads)
+        {
+            thread.join();
+        }
+
+        {
+            std::unique_lock<std::shared_mutex> lock(npcs_mutex);
+            world.applyDeaths();
+            world.syncObjects();
+            publishSnapshot();
+        }
+
+        double seconds = std::chrono::duration<double>(finish - start).count();
+        std::shared_ptr<const WorldSnapshot> snapshot = snapshots.latest();
+        {
+            std::lock_guard<std::mutex> cout_lock(cout_mutex);
+            std::cout << std::fixed << std::setprecision(1)
+                      << "Тиков: " << config.ticks << " за " << seconds * 1000.0 << " мс"
+                      << " | тиков/с: " << (seconds > 0 ? config.ticks / seconds : 0.0)
+                      << " | боёв: " << battlesFought.load()
+                      << " | боёв/с: " << (seconds > 0 ? battlesFought.load() / seconds : 0.0)
+                      << " | выживших: " << snapshot->aliveCount << " из " << config.npcCount << std::endl;
+        }
+        if (heatmapFrames > 0)
+        {
+            std::lock_guard<std::mutex> cout_lock(cout_mutex);
+            std::cout << "Карт плотности: " << heatmapFrames << " | в среднем "
+                      << std::chrono::duration<double, std::milli>(heatmapTime).count() / heatmapFrames
+                      << " мс на кадр (тик: " << seconds * 1000.0 / std::max<uint64_t>(1, config.ticks) << " мс)"
+                      << std::endl;
+        }
+        printQueueStats();
+        printLogStats();
+    }
+
+    // Статистика очереди боёв: сколько задач отфильтровано при постановке
+    void printQueueStats()
+    {
+        BattleQueueStats stats = battleQueue->stats();
+        std::lock_guard<std::mutex> cout_lock(cout_mutex);
+        std::cout << "Задач боёв: " << stats.enqueued
+                  << " | отброшено с мёртвыми: " << stats.droppedDead << std::endl;
+    }
+
+    // Статистика журнала боёв; stop() дописывает остаток буфера в файл
+    void printLogStats()
+    {
+        battleLog->stop();
+        std::lock_guard<std::mutex> cout_lock(cout_mutex);
+        std::cout << "Записей в журнале: " << battleLog->written()
+                  << " | потеряно при переполнении: " << battleLog->dropped() << std::endl;
     }
 
-    // Вывод списка выживших
+    // Вывод списка выживших по последнему снимку мира
     void printSurvivors()
     {
-        std::shared_lock<std::shared_mutex> lock(npcs_mutex);
+        std::shared_ptr<const WorldSnapshot> snapshot = snapshots.latest();
         std::lock_guard<std::mutex> cout_lock(cout_mutex);
 
         std::cout << "\n╔════════════════════════════════════════════════╗" << std::endl;
@@ -277,31 +780,24 @@ public:
         std::cout << "╚════════════════════════════════════════════════╝\n"
                   << std::endl;
 
-        std::vector<std::shared_ptr<NPC>> survivors;
-        for (const auto &npc : npcs)
-        {
-            if (npc->isAlive())
-            {
-                survivors.push_back(npc);
-            }
-        }
-
         std::cout << "═══════════════════════════════════════════════" << std::endl;
-        std::cout << "ВЫЖИВШИЕ: " << survivors.size() << " из " << npcs.size() << std::endl;
+        std::cout << "ВЫЖИВШИЕ: " << snapshot->aliveCount << " из " << snapshot->size() << std::endl;
         std::cout << "═══════════════════════════════════════════════" << std::endl;
 
-        if (survivors.empty())
+        if (snapshot->aliveCount == 0)
         {
             std::cout << "Никто не выжил!" << std::endl;
         }
         else
         {
-            for (const auto &npc : survivors)
+            for (size_t i = 0; i < snapshot->size(); ++i)
             {
-                std::cout << "✓ " << std::left << std::setw(10) << npc->getType()
-                          << " " << std::setw(20) << npc->getName()
+                if (!snapshot->alives[i])
+                    continue;
+                std::cout << "✓ " << std::left << std::setw(10) << npcTypeName(snapshot->types[i])
+                          << " " << std::setw(20) << NameTable::global().name(snapshot->nameIds[i])
                           << " на позиции (" << std::fixed << std::setprecision(1)
-                          << npc->getX() << ", " << npc->getY() << ")" << std::endl;
+                          << snapshot->xs[i] << ", " << snapshot->ys[i] << ")" << std::endl;
             }
         }
         std::cout << "═══════════════════════════════════════════════\n"
@@ -309,14 +805,137 @@ public:
     }
 };
 
-int main()
+// Разбор аргументов командной строки
+GameConfig parseArgs(int argc, char **argv)
+{
+    GameConfig config;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--collision=brute") == 0)
+        {
+            config.collisionMode = CollisionMode::BruteForce;
+        }
+        else if (std::strcmp(argv[i], "--collision=grid") == 0)
+        {
+            config.collisionMode = CollisionMode::Grid;
+        }
+        else if (std::strcmp(argv[i], "--queue=mutex") == 0)
+        {
+            config.queueKind = QueueKind::Mutex;
+        }
+        else if (std::strcmp(argv[i], "--queue=ring") == 0)
+        {
+            config.queueKind = QueueKind::Ring;
+        }
+        else if (std::strcmp(argv[i], "--alloc=heap") == 0)
+        {
+            config.allocation = NPCAllocation::Heap;
+        }
+        else if (std::strcmp(argv[i], "--alloc=pool") == 0)
+        {
+            config.allocation = NPCAllocation::Pool;
+        }
+        else if (std::strncmp(argv[i], "--battle-workers=", 17) == 0)
+        {
+            config.battleWorkers = std::stoi(argv[i] + 17);
+            if (config.battleWorkers < 1)
+            {
+                throw std::invalid_argument("Число потоков боёв должно быть не меньше 1");
+            }
+        }
+        else if (std::strncmp(argv[i], "--seed=", 7) == 0)
+        {
+            config.seed = std::stoull(argv[i] + 7);
+        }
+        else if (std::strcmp(argv[i], "--headless") == 0)
+        {
+            config.headless = true;
+        }
+        else if (std::strncmp(argv[i], "--ticks=", 8) == 0)
+        {
+            config.ticks = std::stoull(argv[i] + 8);
+        }
+        else if (std::strncmp(argv[i], "--fps=", 6) == 0)
+        {
+            config.fps = std::stod(argv[i] + 6);
+            if (config.fps <= 0)
+            {
+                throw std::invalid_argument("Частота кадров должна быть положительной");
+            }
+        }
+        else if (std::strcmp(argv[i], "--view=map") == 0)
+        {
+            config.heatmapView = false;
+        }
+        else if (std::strcmp(argv[i], "--view=heatmap") == 0)
+        {
+            config.heatmapView = true;
+        }
+        else if (std::strncmp(argv[i], "--heatmap-size=", 15) == 0)
+        {
+            if (std::sscanf(argv[i] + 15, "%dx%d", &config.heatmapCols, &config.heatmapRows) != 2 ||
+                config.heatmapCols <= 0 || config.heatmapRows <= 0)
+            {
+                throw std::invalid_argument("Размер карты плотности задаётся как COLSxROWS");
+            }
+        }
+        else if (std::strncmp(argv[i], "--heatmap-out=", 14) == 0)
+        {
+            config.heatmapOut = argv[i] + 14;
+        }
+        else if (std::strncmp(argv[i], "--heatmap-every=", 16) == 0)
+        {
+            config.heatmapEvery = std::stoull(argv[i] + 16);
+            if (config.heatmapEvery == 0)
+            {
+                throw std::invalid_argument("Период записи карты плотности должен быть положительным");
+            }
+        }
+        else if (std::strncmp(argv[i], "--metrics-out=", 14) == 0)
+        {
+            config.metricsOut = argv[i] + 14;
+        }
+        else if (std::strncmp(argv[i], "--metrics-port=", 15) == 0)
+        {
+            config.metricsPort = std::stoi(argv[i] + 15);
+            if (config.metricsPort < 0 || config.metricsPort > 65535)
+            {
+                throw std::invalid_argument("Порт метрик должен быть от 0 до 65535");
+            }
+        }
+        else if (std::strncmp(argv[i], "--metrics-every=", 16) == 0)
+        {
+            config.metricsEveryMs = std::stoi(argv[i] + 16);
+            if (config.metricsEveryMs <= 0)
+            {
+                throw std::invalid_argument("Период записи метрик должен быть положительным");
+            }
+        }
+        else if (std::strncmp(argv[i], "--npcs=", 7) == 0)
+        {
+            config.npcCount = std::stoi(argv[i] + 7);
+            if (config.npcCount < 0)
+            {
+                throw std::invalid_argument("Число NPC не может быть отрицательным");
+            }
+        }
+        else
+        {
+            throw std::invalid_argument(std::string("Неизвестный аргумент: ") + argv[i]);
+        }
+    }
+    return config;
+}
+
+int main(int argc, char **argv)
 {
     try
     {
-        Game game;
+        GameConfig config = parseArgs(argc, argv);
+        Game game(config);
 
         // Генерируем случайных NPC
-        game.generateRandomNPCs(INITIAL_NPC_COUNT);
+        game.generateRandomNPCs(config.npcCount);
 
         // Запускаем игру
         game.run();
@@ -7,10 +7,36 @@
 #include "../include/Observer.h"
 #include "../include/DungeonEditor.h"
 #include "../include/BattleQueue.h"
+#include "../include/RingBattleQueue.h"
+#include "../include/SpatialHashGrid.h"
+#include "../include/QuadTree.h"
+#include "../include/EntityStore.h"
+#include "../include/DistanceKernel.h"
+#include "../include/BattleClaims.h"
+#include "../include/BattleRounds.h"
+#include "../include/CounterRng.h"
+#include "../include/AsyncFileObserver.h"
+#include "../include/WorldSnapshot.h"
+#include "../include/TextLoader.h"
+#include "../include/NPCGenerator.h"
+#include "../include/TerminalRenderer.h"
+#include "../include/DensityHeatmap.h"
+#include "../include/Metrics.h"
+#include "../include/MetricsExporter.h"
 #include <fstream>
 #include <sstream>
 #include <vector>
 #include <functional>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <tuple>
+#include <cstdio>
+#include <iterator>
+#include <map>
+#include <set>
 
 static std::function<int()> makeFixedRoller(std::vector<int> rolls)
 {
@@ -93,6 +119,128 @@ TEST_F(NPCFactoryTest, CreateFromInvalidString)
     EXPECT_EQ(npc, nullptr);
 }
 
+TEST_F(NPCFactoryTest, AssignsDistinctIdsAndSharesNames)
+{
+    auto first = NPCFactory::createNPC("Druid", "Twin", 0, 0);
+    auto second = NPCFactory::createNPC("Druid", "Twin", 5, 5);
+
+    EXPECT_NE(first->getId(), INVALID_NPC_ID);
+    EXPECT_NE(first->getId(), second->getId());
+    EXPECT_EQ(first->getNameId(), second->getNameId());
+    EXPECT_EQ(second->getName(), "Twin");
+}
+
+TEST_F(NPCFactoryTest, PoolAllocationReusesFreedBlocks)
+{
+    NPCFactory::setAllocation(NPCAllocation::Pool);
+    auto knight = NPCFactory::createNPC("Knight", "Pooled", 1, 2);
+    auto elf = NPCFactory::createNPC(NPCType::Elf, "PooledElf", 3, 4);
+    NPCFactory::setAllocation(NPCAllocation::Heap);
+
+    ASSERT_NE(knight, nullptr);
+    EXPECT_EQ(knight->getType(), "Knight");
+    EXPECT_EQ(elf->getType(), "Elf");
+    EXPECT_DOUBLE_EQ(elf->getY(), 4);
+
+    // Освобождённый блок достаётся следующему NPC того же типа
+    const NPC *freed = knight.get();
+    knight.reset();
+    NPCFactory::setAllocation(NPCAllocation::Pool);
+    auto reused = NPCFactory::createNPC("Knight", "Pooled2", 0, 0);
+    NPCFactory::setAllocation(NPCAllocation::Heap);
+    EXPECT_EQ(reused.get(), freed);
+    EXPECT_EQ(reused->getName(), "Pooled2");
+}
+
+// Пулы разделены по типам; поток, который только освобождает, возвращает кэш
+TEST(SlabPoolTest, PoolsArePerTypeAndFreeingThreadFlushesCache)
+{
+    struct First
+    {
+        char bytes[40];
+    };
+    struct Second
+    {
+        char bytes[40];
+    };
+    auto &first = SlabPool<First>::instance();
+    auto &second = SlabPool<Second>::instance();
+    EXPECT_NE((void *)&first, (void *)&second);
+
+    void *block = first.allocate();
+    first.deallocate(block);
+    void *other = second.allocate();
+    EXPECT_NE(other, block);
+    second.deallocate(other);
+
+    std::vector<void *> blocks;
+    for (int i = 0; i < 200; ++i)
+        blocks.push_back(first.allocate());
+    const size_t pooledBefore = first.pooled();
+    std::thread([&first, &blocks]
+                {
+                    for (void *p : blocks)
+                        first.deallocate(p); })
+        .join();
+    EXPECT_EQ(first.pooled(), pooledBefore + blocks.size());
+    EXPECT_EQ(first.live(), 0u);
+}
+
+TEST(TextLoaderTest, ParsesRecordsAndRejectsMalformedLines)
+{
+    std::string text = "Knight Arthur 100.5 200\r\n  Elf\tLegolas 1e2 +3\n\nDruid Merlin 7 8";
+    std::vector<TextLoader::Record> records;
+    TextLoader::Error error;
+    ASSERT_TRUE(TextLoader::parse(text.data(), text.size(), records, error));
+    ASSERT_EQ(records.size(), 3u);
+    EXPECT_EQ(records[0].type, NPCType::Knight);
+    EXPECT_EQ(records[0].name, "Arthur");
+    EXPECT_EQ(records[0].x, 100.5);
+    EXPECT_EQ(records[1].name, "Legolas");
+    EXPECT_EQ(records[1].x, 100.0);
+    EXPECT_EQ(records[1].y, 3.0);
+    EXPECT_EQ(records[2].type, NPCType::Druid);
+
+    const char *bad[] = {"Knight Arthur 1", "Knight Arthur x 2", "Knight Arthur 1 2 3", "Orc Grom 1 2"};
+    for (const char *line : bad)
+    {
+        std::string input = std::string("Elf Ok 1 1\n") + line + "\n";
+        EXPECT_FALSE(TextLoader::parse(input.data(), input.size(), records, error)) << line;
+        EXPECT_EQ(error.line, 2u) << line;
+    }
+}
+
+// Параллельный разбор даёт тот же результат и ту же строку ошибки, что и последовательный
+TEST(TextLoaderTest, ParallelChunksMatchSequentialOrder)
+{
+    std::string text;
+    const size_t count = 100000;
+    for (size_t i = 0; i < count; ++i)
+        text += std::string(npcTypeName((NPCType)(i % 3))) + " N" + std::to_string(i) + " " +
+                std::to_string(i % 500) + " " + std::to_string(i % 499) + "\n";
+    ASSERT_GT(text.size(), TextLoader::PARALLEL_THRESHOLD);
+
+    std::vector<TextLoader::Record> sequential, parallel;
+    TextLoader::Error error;
+    ASSERT_TRUE(TextLoader::parse(text.data(), text.size(), sequential, error, 1));
+    ASSERT_TRUE(TextLoader::parse(text.data(), text.size(), parallel, error, 7));
+    ASSERT_EQ(parallel.size(), count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(parallel[i].name, sequential[i].name);
+        ASSERT_EQ(parallel[i].x, sequential[i].x);
+    }
+
+    // Ошибка в последней трети файла
+    size_t badLine = count * 5 / 6;
+    size_t offset = 0;
+    for (size_t line = 1; line < badLine; ++line)
+        offset = text.find('\n', offset) + 1;
+    text[offset] = '#';
+    EXPECT_FALSE(TextLoader::parse(text.data(), text.size(), parallel, error, 7));
+    EXPECT_EQ(error.line, badLine);
+}
+
 // Тесты расстояния между NPC
 class NPCDistanceTest : public ::testing::Test
 {
@@ -126,6 +274,42 @@ TEST_F(NPCDistanceTest, LargeDistance)
     EXPECT_NEAR(distance, 707.1067, 0.001);
 }
 
+// Читатель никогда не видит координаты из разных записей
+TEST(NPCStateTest, PositionSnapshotIsConsistentUnderConcurrentWrites)
+{
+    Knight knight("SeqlockKnight", 0, 0);
+    std::atomic<bool> done{false};
+
+    std::thread writer([&]
+                       {
+                           for (int i = 0; i < 200000; ++i)
+                               knight.setPosition(i, i);
+                           done = true;
+                       });
+
+    size_t torn = 0;
+    while (!done)
+    {
+        Position pos = knight.getPosition();
+        if (pos.x != pos.y)
+            ++torn;
+    }
+    writer.join();
+
+    EXPECT_EQ(torn, 0u);
+    EXPECT_EQ(knight.getX(), 199999.0);
+}
+
+TEST(NPCStateTest, TakeDamageKillsAtZeroHealth)
+{
+    Druid druid("AtomicDruid", 0, 0);
+    druid.takeDamage(30);
+    EXPECT_TRUE(druid.isAlive());
+    EXPECT_EQ(druid.getHealth(), 50);
+    druid.takeDamage(50);
+    EXPECT_FALSE(druid.isAlive());
+}
+
 // Тесты боевой системы
 class BattleVisitorTest : public ::testing::Test
 {
@@ -238,6 +422,163 @@ TEST_F(BattleVisitorTest, KnightVsDruid_NoDeath)
     EXPECT_TRUE(druid->isAlive());
 }
 
+// Пользовательский Visitor получает типизированную перегрузку через теги типов
+class RecordingVisitor : public Visitor
+{
+public:
+    std::vector<std::string> calls;
+
+    void visitKnight(Knight &, Knight &) override { calls.push_back("KK"); }
+    void visitKnight(Knight &, Druid &) override { calls.push_back("KD"); }
+    void visitKnight(Knight &, Elf &) override { calls.push_back("KE"); }
+    void visitDruid(Druid &, Knight &) override { calls.push_back("DK"); }
+    void visitDruid(Druid &, Druid &) override { calls.push_back("DD"); }
+    void visitDruid(Druid &, Elf &) override { calls.push_back("DE"); }
+    void visitElf(Elf &, Knight &) override { calls.push_back("EK"); }
+    void visitElf(Elf &, Druid &) override { calls.push_back("ED"); }
+    void visitElf(Elf &, Elf &) override { calls.push_back("EE"); }
+};
+
+TEST(VisitorDispatchTest, CustomVisitorReceivesTypedOverloads)
+{
+    Knight k("K", 0, 0);
+    Druid d("D", 0, 0);
+    Elf e("E", 0, 0);
+    RecordingVisitor visitor;
+
+    k.accept(visitor, e);
+    d.accept(visitor, k);
+    e.accept(visitor, d);
+    e.accept(visitor, e);
+
+    EXPECT_EQ(visitor.calls, (std::vector<std::string>{"KE", "DK", "ED", "EE"}));
+}
+
+TEST_F(BattleVisitorTest, DruidVsElf_ElfKillsDruid_WhenDefenseGreater)
+{
+    auto druid = std::make_shared<Druid>("Druid1", 100, 100);
+    auto elf = std::make_shared<Elf>("Elf1", 110, 110);
+
+    BattleVisitor visitor(subject, makeFixedRoller({1, 6}));
+
+    druid->accept(visitor, *elf);
+
+    EXPECT_FALSE(druid->isAlive());
+    EXPECT_TRUE(elf->isAlive());
+}
+
+// Одинаковые seed и контекст боя дают одинаковый исход в любом потоке
+TEST_F(BattleVisitorTest, SeededBattlesAreReproducible)
+{
+    auto runBattles = [this](uint64_t seed)
+    {
+        BattleVisitor visitor(subject, seed);
+        std::vector<int> outcome;
+        for (uint32_t pair = 0; pair < 200; ++pair)
+        {
+            Druid a("A", 0, 0), b("B", 1, 1);
+            visitor.setBattleContext(pair / 10, BattleVisitor::pairKey(pair, pair + 1));
+            a.accept(visitor, b);
+            outcome.push_back((a.isAlive() ? 1 : 0) + (b.isAlive() ? 2 : 0));
+        }
+        return outcome;
+    };
+
+    std::vector<int> first = runBattles(42);
+    std::vector<int> fromThread;
+    std::thread([&]
+                { fromThread = runBattles(42); })
+        .join();
+
+    EXPECT_EQ(first, fromThread);
+    EXPECT_NE(first, runBattles(43));
+    // Встречаются все три исхода: победа атакующего, защищающегося и ничья
+    EXPECT_NE(std::count(first.begin(), first.end(), 1), 0);
+    EXPECT_NE(std::count(first.begin(), first.end(), 2), 0);
+    EXPECT_NE(std::count(first.begin(), first.end(), 3), 0);
+}
+
+TEST(CounterRngTest, DiceIsPureFunctionOfKeys)
+{
+    std::vector<int> faces(7, 0);
+    for (uint64_t k = 0; k < 6000; ++k)
+    {
+        int roll = CounterRng::dice(7, k, k * 3);
+        ASSERT_GE(roll, 1);
+        ASSERT_LE(roll, 6);
+        EXPECT_EQ(roll, CounterRng::dice(7, k, k * 3));
+        ++faces[roll];
+    }
+    for (int face = 1; face <= 6; ++face)
+    {
+        EXPECT_GT(faces[face], 800);
+        EXPECT_LT(faces[face], 1200);
+    }
+
+    double u = CounterRng::uniform(1, 2, 3);
+    EXPECT_GE(u, 0.0);
+    EXPECT_LT(u, 1.0);
+}
+
+TEST(NameTableTest, InternReturnsSameIdForSameName)
+{
+    NameTable &names = NameTable::global();
+    NameId a = names.intern("NameTableTest_A");
+    NameId b = names.intern("NameTableTest_B");
+
+    EXPECT_NE(a, b);
+    EXPECT_EQ(names.intern("NameTableTest_A"), a);
+    EXPECT_EQ(names.find("NameTableTest_B"), b);
+    EXPECT_EQ(names.find("NameTableTest_Missing"), INVALID_NAME);
+    EXPECT_EQ(names.name(a), "NameTableTest_A");
+}
+
+// Индекс ссылается на строки блоков: ключи остаются верными при росте таблицы
+TEST(NameTableTest, InternAllKeepsIndexValidAcrossChunks)
+{
+    auto names = std::make_unique<NameTable>();
+    std::vector<std::string> batch;
+    for (int i = 0; i < 10000; ++i)
+        batch.push_back("NameTableTest_long_name_outside_small_buffer_" + std::to_string(i));
+    batch.push_back(batch[42]); // Повтор внутри пакета
+
+    std::vector<NameId> ids(batch.size());
+    names->internAll(batch, ids.data());
+    EXPECT_EQ(names->size(), 10000u);
+    EXPECT_EQ(ids.back(), ids[42]);
+
+    batch.clear(); // Индекс не держит ссылок на строки вызывающего
+    for (int i = 0; i < 10000; i += 999)
+    {
+        std::string name = "NameTableTest_long_name_outside_small_buffer_" + std::to_string(i);
+        EXPECT_EQ(names->find(name), ids[i]);
+        EXPECT_EQ(names->intern(name), ids[i]);
+        EXPECT_EQ(names->name(ids[i]), name);
+    }
+}
+
+// Пакетная генерация: результат для seed не зависит от числа потоков
+TEST(NPCGeneratorTest, ResultDoesNotDependOnThreadCount)
+{
+    const size_t count = 50000;
+    auto single = NPCGenerator::generate(42, count, 100, 100, 1);
+    auto parallel = NPCGenerator::generate(42, count, 100, 100, 8);
+    ASSERT_EQ(single.size(), count);
+    ASSERT_EQ(parallel.size(), count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        ASSERT_EQ(parallel[i]->getTypeTag(), single[i]->getTypeTag());
+        ASSERT_EQ(parallel[i]->getX(), single[i]->getX());
+        ASSERT_EQ(parallel[i]->getY(), single[i]->getY());
+        ASSERT_EQ(parallel[i]->getNameId(), single[i]->getNameId()); // Те же имена — те же NameId
+        ASSERT_EQ(parallel[i]->getId(), parallel[0]->getId() + i);
+    }
+    EXPECT_EQ(single[0]->getName(), std::string(npcTypeName(single[0]->getTypeTag())) + "_1");
+    EXPECT_LE(single[count - 1]->getX(), 100.0);
+    EXPECT_NE(NPCGenerator::generate(43, 1, 100, 100)[0]->getX(), single[0]->getX());
+}
+
 // Тесты Observer
 class ObserverTest : public ::testing::Test
 {
@@ -284,6 +625,136 @@ TEST_F(ObserverTest, MultipleObservers)
     file.close();
 }
 
+// Наблюдатель, сохраняющий структурированные события и их текст
+class KillEventRecorder : public Observer
+{
+public:
+    std::vector<KillEvent> events;
+    std::vector<std::string> lines;
+
+    void onKill(const std::string &killer, const std::string &victim) override
+    {
+        lines.push_back(killer + " убил(а) " + victim);
+    }
+
+    void onKillEvent(const KillEvent &event) override
+    {
+        events.push_back(event);
+        Observer::onKillEvent(event);
+    }
+};
+
+TEST_F(ObserverTest, KillEventCarriesParticipantsAndRolls)
+{
+    auto recorder = std::make_shared<KillEventRecorder>();
+    subject.attach(recorder);
+
+    auto knight = NPCFactory::createNPC("Knight", "Arthur", 0, 0);
+    auto elf = NPCFactory::createNPC("Elf", "Legolas", 1, 1);
+    BattleVisitor visitor(subject, makeFixedRoller({2, 5})); // защита > атака
+    visitor.setBattleContext(7, 0);
+    knight->accept(visitor, *elf);
+
+    ASSERT_EQ(recorder->events.size(), 1u);
+    const KillEvent &event = recorder->events[0];
+    EXPECT_EQ(event.killerId, elf->getId());
+    EXPECT_EQ(event.victimId, knight->getId());
+    EXPECT_EQ(event.killerName, elf->getNameId());
+    EXPECT_EQ(event.victimName, knight->getNameId());
+    EXPECT_EQ(event.killerType, NPCType::Elf);
+    EXPECT_EQ(event.victimType, NPCType::Knight);
+    EXPECT_EQ(event.attackRoll, 2);
+    EXPECT_EQ(event.defenseRoll, 5);
+    EXPECT_TRUE(event.byDefender);
+    EXPECT_EQ(event.tick, 7u);
+
+    ASSERT_EQ(recorder->lines.size(), 1u);
+    EXPECT_EQ(recorder->lines[0], "Legolas (Elf) убил(а) Arthur (Knight) [Защита:5 > Атака:2]");
+}
+
+TEST_F(ObserverTest, AsyncFileObserverWritesAfterFlush)
+{
+    auto fileObserver = std::make_shared<AsyncFileObserver>(testLogFile);
+    subject.attach(fileObserver);
+
+    Druid druid("Merlin", 0, 0), victim("Radagast", 1, 1);
+    subject.notify("Knight", "Elf");
+    subject.notify(KillEvent{druid.getId(), victim.getId(), druid.getNameId(), victim.getNameId(), NPCType::Druid, NPCType::Druid, 6, 1, false, 0});
+    fileObserver->flush();
+
+    std::ifstream file(testLogFile);
+    ASSERT_TRUE(file.is_open());
+    std::string line;
+    std::getline(file, line);
+    EXPECT_EQ(line, "Knight убил(а) Elf");
+    std::getline(file, line);
+    EXPECT_EQ(line, "Merlin (Druid) убил(а) Radagast (Druid) [Атака:6 > Защита:1]");
+    EXPECT_EQ(fileObserver->depth(), 0u);
+}
+
+// Несколько производителей: после stop() в файле все принятые события
+TEST_F(ObserverTest, AsyncFileObserverDrainsOnStop)
+{
+    const int threads = 4, perThread = 5000;
+    auto fileObserver = std::make_shared<AsyncFileObserver>(testLogFile, 1024);
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < threads; ++t)
+    {
+        producers.emplace_back([&fileObserver, t]
+                               {
+                                   for (int i = 0; i < perThread; ++i)
+                                       fileObserver->onKill("Knight_" + std::to_string(t), "Elf_" + std::to_string(i));
+                               });
+    }
+    for (auto &producer : producers)
+        producer.join();
+    fileObserver->stop();
+
+    std::ifstream file(testLogFile);
+    size_t lines = 0;
+    std::string line;
+    while (std::getline(file, line))
+        ++lines;
+
+    EXPECT_EQ(lines, fileObserver->written());
+    EXPECT_EQ(fileObserver->accepted(), fileObserver->written());
+    EXPECT_EQ(fileObserver->accepted() + fileObserver->dropped(), (uint64_t)threads * perThread);
+    EXPECT_EQ(fileObserver->depth(), 0u);
+}
+
+// stop() во время записи: каждое принятое событие попадает в файл
+TEST_F(ObserverTest, AsyncFileObserverStopWritesEveryAcceptedEvent)
+{
+    for (int attempt = 0; attempt < 20; ++attempt)
+    {
+        auto fileObserver = std::make_shared<AsyncFileObserver>(testLogFile, 64);
+        Druid druid("Merlin", 0, 0), victim("Radagast", 1, 1);
+        KillEvent event{druid.getId(), victim.getId(), druid.getNameId(), victim.getNameId(),
+                        NPCType::Druid, NPCType::Druid, 6, 1, false, 0};
+
+        std::atomic<bool> running{true};
+        std::vector<std::thread> producers;
+        for (int t = 0; t < 3; ++t)
+        {
+            producers.emplace_back([&fileObserver, &running, &event]
+                                   {
+                                       while (running.load(std::memory_order_relaxed))
+                                           fileObserver->onKillEvent(event);
+                                   });
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        fileObserver->stop();
+        running.store(false, std::memory_order_relaxed);
+        for (auto &producer : producers)
+            producer.join();
+
+        EXPECT_EQ(fileObserver->accepted(), fileObserver->written());
+        EXPECT_EQ(fileObserver->depth(), 0u);
+        std::remove(testLogFile.c_str());
+    }
+}
+
 // Тесты DungeonEditor
 class DungeonEditorTest : public ::testing::Test
 {
@@ -343,6 +814,79 @@ TEST_F(DungeonEditorTest, SaveAndLoadFromFile)
     EXPECT_EQ(editor2.getNPCCount(), 3);
 }
 
+TEST_F(DungeonEditorTest, BinarySaveRoundTrip)
+{
+    const std::string binFile = "test_dungeon.bin";
+    editor.addNPC("Knight", "Arthur", 100.25, 100.5);
+    editor.addNPC("Druid", "Merlin", 200, 200);
+    editor.addNPC("Elf", "Legolas", 300, 300);
+
+    ASSERT_TRUE(editor.saveToFile(binFile, SaveFormat::Binary));
+
+    MappedFile mapped(binFile);
+    ASSERT_TRUE(mapped.isOpen());
+    EXPECT_TRUE(BinarySave::isBinary(mapped.data(), mapped.size()));
+    EXPECT_EQ(mapped.size(), sizeof(BinarySave::Header) + 3 * sizeof(BinarySave::Record) +
+                                 std::string("ArthurMerlinLegolas").size());
+    // Порядок байтов в файле — little-endian независимо от машины
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(mapped.data());
+    EXPECT_EQ(std::string(mapped.data(), 4), "DNPC");
+    EXPECT_EQ(bytes[4], BinarySave::VERSION);
+    EXPECT_EQ(bytes[5], 0);
+    EXPECT_EQ(bytes[sizeof(BinarySave::Header) + 6], 0x59); // 100.25 = 0x4059100000000000
+    EXPECT_EQ(bytes[sizeof(BinarySave::Header) + 7], 0x40);
+
+    std::vector<std::string> lines;
+    BinarySave::read(mapped.data(), mapped.size(), [&lines](NPCType type, const std::string &name, double x, double y)
+                     { lines.push_back(NPCFactory::createNPC(npcTypeName(type), name, x, y)->serialize()); });
+    ASSERT_EQ(lines.size(), 3u);
+    EXPECT_EQ(lines[0], Knight("Arthur", 100.25, 100.5).serialize());
+
+    DungeonEditor loaded;
+    EXPECT_TRUE(loaded.loadFromFile(binFile));
+    EXPECT_EQ(loaded.getNPCCount(), 3);
+    // Имена заняты — значит, загружены верно
+    EXPECT_FALSE(loaded.addNPC("Knight", "Legolas", 1, 1));
+    std::remove(binFile.c_str());
+}
+
+TEST_F(DungeonEditorTest, CorruptedBinarySaveIsRejected)
+{
+    const std::string binFile = "test_dungeon.bin";
+    editor.addNPC("Knight", "Arthur", 100, 100);
+    ASSERT_TRUE(editor.saveToFile(binFile, SaveFormat::Binary));
+
+    // Обрезаем таблицу строк
+    std::string bytes;
+    {
+        std::ifstream in(binFile, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream out(binFile, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), (std::streamsize)bytes.size() - 3);
+    }
+
+    DungeonEditor loaded;
+    loaded.addNPC("Elf", "Keeper", 1, 1);
+    EXPECT_FALSE(loaded.loadFromFile(binFile));
+    EXPECT_EQ(loaded.getNPCCount(), 1); // Прежнее состояние сохраняется
+    std::remove(binFile.c_str());
+}
+
+TEST_F(DungeonEditorTest, LoadReportsLineOfBadRecord)
+{
+    {
+        std::ofstream out(testFile);
+        out << "Knight Arthur 1 2\n\nElf Legolas 3 4\nDragon Smaug 5 6\n";
+    }
+    editor.addNPC("Druid", "Keeper", 1, 1);
+
+    EXPECT_FALSE(editor.loadFromFile(testFile));
+    EXPECT_NE(editor.getLoadError().find("строка 4"), std::string::npos);
+    EXPECT_EQ(editor.getNPCCount(), 1);
+}
+
 TEST_F(DungeonEditorTest, LoadFromNonExistentFile)
 {
     EXPECT_FALSE(editor.loadFromFile("nonexistent.txt"));
@@ -392,6 +936,46 @@ TEST_F(DungeonEditorTest, BattleMode_ComplexScenario)
     EXPECT_EQ(editor.getNPCCount(), 3); // K1, D1, K2
 }
 
+TEST_F(DungeonEditorTest, BattleMode_RepeatedAfterRemoval)
+{
+    editor.addNPC("Knight", "K1", 100, 100);
+    editor.addNPC("Elf", "E1", 110, 110);
+    editor.addNPC("Druid", "D1", 120, 120);
+    editor.addNPC("Druid", "D2", 125, 125);
+
+    Subject subj;
+    // K1 vs E1: E1 умирает; K1 vs D1, K1 vs D2: ничья; D1 vs D2: D2 умирает
+    BattleVisitor visitor(subj, makeFixedRoller({6, 1, 6, 1, 6, 1, 6, 1}));
+    editor.startBattle(50, visitor);
+    EXPECT_EQ(editor.getNPCCount(), 2); // K1, D1
+
+    // Повторный бой по обновлённому индексу: пар, способных убивать, не осталось
+    BattleVisitor visitor2(subj, makeFixedRoller({6, 1}));
+    editor.startBattle(50, visitor2);
+    EXPECT_EQ(editor.getNPCCount(), 2);
+
+    // Имя погибшего освобождается в индексе имён
+    EXPECT_TRUE(editor.addNPC("Elf", "E1", 300, 300));
+    EXPECT_FALSE(editor.addNPC("Druid", "D1", 300, 300));
+}
+
+TEST_F(DungeonEditorTest, AddNPCsSkipsInvalidAndDuplicateEntries)
+{
+    editor.addNPC("Knight", "Arthur", 1, 1);
+
+    std::vector<NPCSpec> specs = {
+        {"Druid", "Merlin", 10, 10},
+        {"Elf", "Arthur", 20, 20},    // Имя уже есть в редакторе
+        {"Elf", "Merlin", 30, 30},    // Повтор внутри пакета
+        {"Knight", "Far", 600, 10},   // За пределами карты
+        {"Orc", "Grom", 40, 40},      // Неизвестный тип
+        {"Elf", "Legolas", 500, 500},
+    };
+    EXPECT_EQ(editor.addNPCs(specs), 2u);
+    EXPECT_EQ(editor.getNPCCount(), 3);
+    EXPECT_FALSE(editor.addNPC("Knight", "Legolas", 2, 2));
+}
+
 // Тесты характеристик ЛР7 (ход/убийство)
 TEST(NPCRangesTest, MoveAndKillRanges)
 {
@@ -441,6 +1025,23 @@ TEST(BattleQueueTest, PushPopOrder)
     EXPECT_EQ(t2.defender->getName(), "C");
 }
 
+// Задача боя не владеет участниками и не меняет счётчики ссылок
+TEST(BattleQueueTest, TasksDoNotTouchReferenceCounts)
+{
+    auto a = NPCFactory::createNPC("Knight", "A", 0, 0);
+    auto b = NPCFactory::createNPC("Elf", "B", 0, 0);
+    BattleQueue q;
+    q.push(BattleTask(a, b, 0, 1));
+    std::vector<BattleTask> copies(8, BattleTask(a, b));
+    EXPECT_EQ(a.use_count(), 1);
+    EXPECT_EQ(b.use_count(), 1);
+
+    BattleTask t(nullptr, nullptr);
+    ASSERT_TRUE(q.pop(t));
+    EXPECT_EQ(t.attacker, a.get());
+    EXPECT_EQ(t.defender, b.get());
+}
+
 TEST(BattleQueueTest, StopUnblocksAndPopReturnsFalseWhenEmpty)
 {
     BattleQueue q;
@@ -449,6 +1050,1081 @@ TEST(BattleQueueTest, StopUnblocksAndPopReturnsFalseWhenEmpty)
     EXPECT_FALSE(q.pop(t));
 }
 
+TEST(BattleQueueTest, PushNPopNBatch)
+{
+    BattleQueue q;
+    std::vector<BattleTask> tasks;
+    for (EntityHandle h = 0; h < 5; ++h)
+        tasks.emplace_back(nullptr, nullptr, h, h + 1);
+    q.push_n(tasks.data(), tasks.size());
+
+    std::vector<BattleTask> out(3, BattleTask(nullptr, nullptr));
+    ASSERT_EQ(q.pop_n(out.data(), out.size()), 3u);
+    EXPECT_EQ(out[0].attackerHandle, 0u);
+    EXPECT_EQ(out[2].attackerHandle, 2u);
+    ASSERT_EQ(q.pop_n(out.data(), out.size()), 2u);
+    EXPECT_EQ(out[1].attackerHandle, 4u);
+}
+
+TEST(BattleQueueTest, DuplicatePairIsCoalescedUntilPopped)
+{
+    RingBattleQueue q(16);
+    auto a = NPCFactory::createNPC("Knight", "A", 0, 0);
+    auto b = NPCFactory::createNPC("Elf", "B", 0, 0);
+
+    q.push(BattleTask(a, b, 0, 1, 1));
+    q.push(BattleTask(a, b, 0, 1, 2)); // тот же бой в следующем тике
+    q.push(BattleTask(b, a, 1, 0, 2)); // та же пара в обратном порядке
+    EXPECT_EQ(q.stats().enqueued, 1u);
+    EXPECT_EQ(q.stats().coalesced, 2u);
+    EXPECT_EQ(q.pendingPairs(), 1u);
+
+    BattleTask t(nullptr, nullptr);
+    ASSERT_TRUE(q.pop(t));
+    EXPECT_EQ(t.epoch, 1u);
+    EXPECT_EQ(q.pendingPairs(), 0u);
+
+    // После извлечения пара снова может попасть в очередь
+    q.push(BattleTask(a, b, 0, 1, 3));
+    EXPECT_EQ(q.stats().enqueued, 2u);
+}
+
+TEST(BattleQueueTest, WithoutCoalescingPairsAreNotTracked)
+{
+    BattleQueue q(false);
+    auto a = NPCFactory::createNPC("Knight", "A", 0, 0);
+    auto b = NPCFactory::createNPC("Elf", "B", 0, 0);
+    auto dead = NPCFactory::createNPC("Druid", "C", 0, 0);
+    dead->kill();
+
+    q.push(BattleTask(a, b, 0, 1, 1));
+    q.push(BattleTask(a, b, 0, 1, 2));
+    q.push(BattleTask(a, dead, 0, 2, 2)); // мёртвые отбрасываются и без объединения
+    EXPECT_EQ(q.stats().enqueued, 2u);
+    EXPECT_EQ(q.stats().coalesced, 0u);
+    EXPECT_EQ(q.stats().droppedDead, 1u);
+    EXPECT_EQ(q.pendingPairs(), 0u);
+}
+
+TEST(BattleQueueTest, TasksWithDeadNPCAreDropped)
+{
+    BattleQueue q;
+    auto a = NPCFactory::createNPC("Knight", "A", 0, 0);
+    auto b = NPCFactory::createNPC("Elf", "B", 0, 0);
+    auto c = NPCFactory::createNPC("Druid", "C", 0, 0);
+    b->kill();
+
+    std::vector<BattleTask> batch = {BattleTask(a, b, 0, 1), BattleTask(a, c, 0, 2), BattleTask(b, c, 1, 2)};
+    q.push_n(batch.data(), batch.size());
+
+    EXPECT_EQ(q.stats().droppedDead, 2u);
+    EXPECT_EQ(q.stats().enqueued, 1u);
+
+    BattleTask t(nullptr, nullptr);
+    ASSERT_TRUE(q.pop(t));
+    EXPECT_EQ(t.defender->getName(), "C");
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(BattleQueueTest, RingPushPopOrder)
+{
+    RingBattleQueue q(8);
+    auto a = NPCFactory::createNPC("Knight", "A", 0, 0);
+    auto b = NPCFactory::createNPC("Druid", "B", 0, 0);
+
+    q.push(BattleTask(a, b));
+    q.push(BattleTask(b, a));
+
+    BattleTask t(nullptr, nullptr);
+    ASSERT_TRUE(q.pop(t));
+    EXPECT_EQ(t.attacker->getName(), "A");
+    ASSERT_TRUE(q.pop(t));
+    EXPECT_EQ(t.attacker->getName(), "B");
+    EXPECT_TRUE(q.empty());
+}
+
+TEST(BattleQueueTest, RingStopDrainsThenReturnsFalse)
+{
+    RingBattleQueue q(8);
+    q.push(BattleTask(nullptr, nullptr, 1, 2));
+    q.stop();
+
+    BattleTask t(nullptr, nullptr);
+    ASSERT_TRUE(q.pop(t));
+    EXPECT_EQ(t.attackerHandle, 1u);
+    EXPECT_FALSE(q.pop(t));
+}
+
+// После остановки заполненная очередь отбрасывает остаток пакета;
+// в статистике и глубине учитываются только принятые задачи
+TEST(BattleQueueTest, RingCountsOnlyAcceptedTasksAfterStop)
+{
+    Gauge &depth = MetricsRegistry::global().gauge("dungeon_battle_queue_depth", "");
+    const int64_t depthBefore = depth.value();
+
+    RingBattleQueue q(4);
+    q.stop();
+    std::vector<BattleTask> batch;
+    for (EntityHandle id = 0; id < 6; ++id)
+        batch.emplace_back(nullptr, nullptr, id, id + 100);
+    q.push_n(batch.data(), batch.size());
+
+    EXPECT_EQ(q.stats().enqueued, 4u);
+    EXPECT_EQ(q.dropped(), 2u);
+    EXPECT_EQ(q.pendingPairs(), 4u);
+    EXPECT_EQ(depth.value() - depthBefore, 4);
+
+    std::vector<BattleTask> out(8, BattleTask(nullptr, nullptr));
+    EXPECT_EQ(q.pop_n(out.data(), out.size()), 4u);
+    EXPECT_EQ(out[3].attackerHandle, 3u);
+    EXPECT_EQ(depth.value(), depthBefore);
+    EXPECT_EQ(q.pendingPairs(), 0u);
+}
+
+TEST(BattleQueueTest, RingStopUnblocksWaitingConsumer)
+{
+    RingBattleQueue q(8);
+    std::atomic<bool> result{true};
+    std::thread consumer([&]
+                         {
+        BattleTask t(nullptr, nullptr);
+        result = q.pop(t); });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    q.stop();
+    consumer.join();
+    EXPECT_FALSE(result);
+}
+
+// Под нагрузкой: несколько производителей и потребителей, маленький буфер.
+// Каждая задача должна быть получена ровно один раз.
+static void runContention(BattleTaskQueue &q)
+{
+    const int PRODUCERS = 4, CONSUMERS = 4, PER_PRODUCER = 20000;
+    std::vector<std::atomic<int>> seen(PRODUCERS * PER_PRODUCER);
+    for (auto &s : seen)
+        s = 0;
+
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < CONSUMERS; ++c)
+    {
+        consumers.emplace_back([&]
+                               {
+            std::vector<BattleTask> batch(16, BattleTask(nullptr, nullptr));
+            while (size_t n = q.pop_n(batch.data(), batch.size()))
+            {
+                for (size_t k = 0; k < n; ++k)
+                    seen[batch[k].attackerHandle]++;
+            } });
+    }
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; ++p)
+    {
+        producers.emplace_back([&, p]
+                               {
+            std::vector<BattleTask> batch;
+            for (int i = 0; i < PER_PRODUCER; ++i)
+            {
+                EntityHandle id = (EntityHandle)(p * PER_PRODUCER + i);
+                if (i % 2)
+                {
+                    q.push(BattleTask(nullptr, nullptr, id, id));
+                }
+                else
+                {
+                    batch.emplace_back(nullptr, nullptr, id, id);
+                }
+                if (batch.size() == 32)
+                {
+                    q.push_n(batch.data(), batch.size());
+                    batch.clear();
+                }
+            }
+            q.push_n(batch.data(), batch.size()); });
+    }
+
+    for (auto &t : producers)
+        t.join();
+    q.stop();
+    for (auto &t : consumers)
+        t.join();
+
+    for (size_t i = 0; i < seen.size(); ++i)
+        ASSERT_EQ(seen[i], 1) << "задача " << i;
+}
+
+TEST(BattleQueueTest, RingUnderContention)
+{
+    RingBattleQueue q(64);
+    runContention(q);
+    EXPECT_EQ(q.dropped(), 0u);
+}
+
+TEST(BattleQueueTest, MutexUnderContention)
+{
+    BattleQueue q;
+    runContention(q);
+}
+
+// Тесты захвата NPC потоками боёв
+TEST(BattleClaimsTest, SharedNPCCannotBeClaimedTwice)
+{
+    BattleClaims claims;
+    claims.resize(4);
+
+    EXPECT_TRUE(claims.tryClaim(0, 1));
+    EXPECT_FALSE(claims.tryClaim(1, 2));
+    EXPECT_FALSE(claims.tryClaim(2, 0));
+    // Неудачный захват откатывается: NPC 2 свободен
+    EXPECT_TRUE(claims.tryClaim(2, 3));
+
+    claims.release(0, 1);
+    EXPECT_TRUE(claims.tryClaim(1, 0));
+}
+
+// Наблюдатель, считающий смерти каждой жертвы
+class KillCountObserver : public Observer
+{
+public:
+    std::mutex mtx;
+    std::map<std::string, int> deaths;
+
+    void onKill(const std::string &, const std::string &victim) override
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        deaths[victim.substr(0, victim.find(' '))]++;
+    }
+};
+
+TEST(BattleClaimsTest, ParallelWorkersNeverKillTwice)
+{
+    const int NPC_COUNT = 64, WORKERS = 8, TASKS_PER_WORKER = 4000;
+    std::vector<std::shared_ptr<NPC>> npcs;
+    for (int i = 0; i < NPC_COUNT; ++i)
+        npcs.push_back(NPCFactory::createNPC("Druid", "D" + std::to_string(i), 0, 0));
+
+    Subject subject;
+    auto counter = std::make_shared<KillCountObserver>();
+    subject.attach(counter);
+
+    BattleClaims claims;
+    claims.resize(NPC_COUNT);
+
+    std::vector<std::thread> workers;
+    for (int w = 0; w < WORKERS; ++w)
+    {
+        workers.emplace_back([&, w]
+                             {
+            std::mt19937 gen(w);
+            std::uniform_int_distribution<int> pick(0, NPC_COUNT - 1);
+            BattleVisitor visitor(subject);
+            for (int t = 0; t < TASKS_PER_WORKER; ++t)
+            {
+                EntityHandle a = pick(gen), b = pick(gen);
+                if (a == b)
+                    continue;
+                while (!claims.tryClaim(a, b))
+                    std::this_thread::yield();
+                if (npcs[a]->isAlive() && npcs[b]->isAlive())
+                    npcs[a]->accept(visitor, *npcs[b]);
+                claims.release(a, b);
+            } });
+    }
+    for (auto &t : workers)
+        t.join();
+
+    for (const auto &entry : counter->deaths)
+        EXPECT_EQ(entry.second, 1) << entry.first;
+}
+
+// Тесты раундов боёв
+TEST(BattleRoundsTest, RoundsShareNoNPCAndKeepEachNPCOrder)
+{
+    std::mt19937 gen(3);
+    std::uniform_int_distribution<EntityHandle> pick(0, 49);
+    std::vector<BattleTask> tasks;
+    for (int k = 0; k < 400; ++k)
+    {
+        EntityHandle a = pick(gen), b = pick(gen);
+        if (a != b)
+            tasks.emplace_back(nullptr, nullptr, a, b, 7 - k % 2);
+    }
+    const size_t total = tasks.size();
+
+    BattleRounds rounds;
+    rounds.plan(tasks);
+    EXPECT_TRUE(tasks.empty());
+    ASSERT_EQ(rounds.size(), total);
+
+    // Последняя задача каждого NPC: (эпоха, ключ); бои NPC идут по неубыванию (повторы пары равны)
+    std::map<EntityHandle, std::pair<uint64_t, uint64_t>> last;
+    for (size_t r = 0; r < rounds.rounds(); ++r)
+    {
+        std::set<EntityHandle> busy;
+        for (size_t k = 0; k < rounds.roundSize(r); ++k)
+        {
+            const BattleTask &task = rounds.round(r)[k];
+            std::pair<uint64_t, uint64_t> order(task.epoch, BattleRounds::orderKey(task));
+            for (EntityHandle handle : {task.attackerHandle, task.defenderHandle})
+            {
+                EXPECT_TRUE(busy.insert(handle).second) << "раунд " << r << ", NPC " << handle;
+                if (last.count(handle))
+                {
+                    EXPECT_LE(last[handle], order) << "NPC " << handle;
+                }
+                last[handle] = order;
+            }
+        }
+    }
+}
+
+// Наблюдатель, записывающий убийства по именам
+class KillListObserver : public Observer
+{
+public:
+    std::mutex mtx;
+    std::vector<std::tuple<uint64_t, NameId, NameId>> kills;
+
+    void onKill(const std::string &, const std::string &) override {}
+
+    void onKillEvent(const KillEvent &event) override
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        kills.emplace_back(event.tick, event.killerName, event.victimName);
+    }
+};
+
+// Бои нескольких тиков раундами через очередь, как в Game::step;
+// возвращает убийства, упорядоченные по (тик, убийца, жертва)
+static std::vector<std::tuple<uint64_t, NameId, NameId>> runBattleRounds(int workers, uint64_t seed)
+{
+    const int NPC_COUNT = 200, TICKS = 5, PAIRS_PER_TICK = 600;
+    const NPCType TYPES[] = {NPCType::Knight, NPCType::Druid, NPCType::Elf};
+    std::vector<std::shared_ptr<NPC>> npcs;
+    for (int i = 0; i < NPC_COUNT; ++i)
+        npcs.push_back(NPCFactory::createNPC(TYPES[i % 3], "R" + std::to_string(i), 0, 0));
+
+    Subject subject;
+    auto log = std::make_shared<KillListObserver>();
+    subject.attach(log);
+
+    BattleQueue queue;
+    std::atomic<uint64_t> handled{0};
+    std::vector<std::thread> threads;
+    for (int w = 0; w < workers; ++w)
+    {
+        threads.emplace_back([&]
+                             {
+            BattleVisitor visitor(subject, seed);
+            BattleTask task(nullptr, nullptr);
+            while (queue.pop(task))
+            {
+                if (task.attacker->isAlive() && task.defender->isAlive())
+                {
+                    visitor.setBattleContext(task.epoch,
+                                             BattleVisitor::pairKey(task.attackerHandle, task.defenderHandle));
+                    task.attacker->accept(visitor, *task.defender);
+                }
+                handled.fetch_add(1, std::memory_order_release);
+            } });
+    }
+
+    // Пары тика в случайном порядке: раунды не зависят от порядка обнаружения
+    std::mt19937 gen(1);
+    std::uniform_int_distribution<int> pick(0, NPC_COUNT - 1);
+    BattleRounds rounds;
+    for (uint64_t tick = 0; tick < TICKS; ++tick)
+    {
+        std::vector<BattleTask> tasks;
+        for (int k = 0; k < PAIRS_PER_TICK; ++k)
+        {
+            EntityHandle a = pick(gen), b = pick(gen);
+            if (a != b)
+                tasks.emplace_back(npcs[a].get(), npcs[b].get(), a, b, tick);
+        }
+        rounds.plan(tasks);
+        for (size_t r = 0; r < rounds.rounds(); ++r)
+        {
+            queue.push_n(rounds.round(r), rounds.roundSize(r));
+            while (handled.load(std::memory_order_acquire) < queue.stats().enqueued)
+                std::this_thread::yield();
+        }
+    }
+    queue.stop();
+    for (auto &t : threads)
+        t.join();
+
+    std::sort(log->kills.begin(), log->kills.end());
+    return log->kills;
+}
+
+TEST(BattleRoundsTest, KillsDoNotDependOnWorkerCount)
+{
+    auto single = runBattleRounds(1, 42);
+    EXPECT_FALSE(single.empty());
+    for (int workers : {2, 4, 8})
+        EXPECT_EQ(runBattleRounds(workers, 42), single) << workers << " потоков";
+}
+
+// Тесты сетки для поиска столкновений
+TEST(SpatialHashGridTest, FindsAllPairsWithinCellSize)
+{
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> pos(0.0, 300.0);
+    std::vector<double> xs, ys;
+    for (int i = 0; i < 500; ++i)
+    {
+        xs.push_back(pos(gen));
+        ys.push_back(pos(gen));
+    }
+
+    const double range = 20.0;
+    SpatialHashGrid grid(range);
+    grid.build(xs, ys);
+
+    std::vector<std::pair<size_t, size_t>> expected;
+    for (size_t i = 0; i < xs.size(); ++i)
+    {
+        for (size_t j = i + 1; j < xs.size(); ++j)
+        {
+            if (std::hypot(xs[i] - xs[j], ys[i] - ys[j]) <= range)
+                expected.emplace_back(i, j);
+        }
+    }
+
+    std::vector<std::pair<size_t, size_t>> found;
+    for (const auto &p : grid.candidatePairs())
+    {
+        if (std::hypot(xs[p.first] - xs[p.second], ys[p.first] - ys[p.second]) <= range)
+            found.push_back(p);
+    }
+
+    EXPECT_EQ(found, expected);
+}
+
+TEST(SpatialHashGridTest, NoDuplicatePairs)
+{
+    std::vector<double> xs = {0, 1, 2, 15, 16, 40};
+    std::vector<double> ys = {0, 1, 2, 15, 16, 40};
+    SpatialHashGrid grid(10.0);
+    grid.build(xs, ys);
+
+    auto pairs = grid.candidatePairs();
+    EXPECT_TRUE(std::adjacent_find(pairs.begin(), pairs.end()) == pairs.end());
+    for (const auto &p : pairs)
+        EXPECT_LT(p.first, p.second);
+}
+
+// Тесты квадродерева
+TEST(QuadTreeTest, RadiusQueryMatchesBruteForce)
+{
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<double> pos(0.0, 500.0);
+    std::vector<double> xs, ys;
+    QuadTree tree(0, 0, 500, 500);
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        xs.push_back(pos(gen));
+        ys.push_back(pos(gen));
+        tree.insert(i, xs[i], ys[i]);
+    }
+    // Точка за пределами границ тоже должна находиться
+    xs.push_back(510);
+    ys.push_back(250);
+    tree.insert(1000, 510, 250);
+
+    for (double r : {0.0, 5.0, 37.5, 120.0})
+    {
+        for (size_t q = 0; q < xs.size(); q += 97)
+        {
+            std::vector<size_t> expected, found;
+            for (size_t i = 0; i < xs.size(); ++i)
+            {
+                double dx = xs[i] - xs[q], dy = ys[i] - ys[q];
+                if (dx * dx + dy * dy <= r * r)
+                    expected.push_back(i);
+            }
+            tree.queryRadius(xs[q], ys[q], r, [&found](size_t key)
+                             { found.push_back(key); });
+            std::sort(found.begin(), found.end());
+            EXPECT_EQ(found, expected);
+        }
+    }
+}
+
+TEST(QuadTreeTest, RemoveDropsPoint)
+{
+    QuadTree tree(0, 0, 100, 100);
+    for (size_t i = 0; i < 50; ++i)
+        tree.insert(i, 10 + i * 0.1, 10);
+
+    EXPECT_TRUE(tree.remove(3, 10.3, 10));
+    EXPECT_FALSE(tree.remove(3, 10.3, 10));
+    EXPECT_EQ(tree.size(), 49u);
+
+    std::vector<size_t> found;
+    tree.queryRadius(10, 10, 100, [&found](size_t key)
+                     { found.push_back(key); });
+    EXPECT_EQ(found.size(), 49u);
+    EXPECT_EQ(std::count(found.begin(), found.end(), 3u), 0);
+}
+
+// Тесты пакетной проверки расстояний
+TEST(WorldSnapshotTest, CaptureCopiesStoreColumns)
+{
+    EntityStore store;
+    store.add(NPCFactory::createNPC("Knight", "SnapKnight", 10, 20));
+    store.add(NPCFactory::createNPC("Elf", "SnapElf", 30, 40));
+    store.setAlive(1, false);
+
+    WorldSnapshot snapshot;
+    snapshot.capture(store, 5);
+
+    ASSERT_EQ(snapshot.size(), 2u);
+    EXPECT_EQ(snapshot.tick, 5u);
+    EXPECT_EQ(snapshot.aliveCount, 1u);
+    EXPECT_EQ(snapshot.xs[1], 30);
+    EXPECT_EQ(snapshot.ys[0], 20);
+    EXPECT_EQ(snapshot.types[1], NPCType::Elf);
+    EXPECT_EQ(NameTable::global().name(snapshot.nameIds[0]), "SnapKnight");
+    EXPECT_FALSE(snapshot.alives[1]);
+}
+
+// Снимок, который держит читатель, не перезаписывается писателем
+TEST(WorldSnapshotTest, PublisherRecyclesOnlyUnreferencedBuffers)
+{
+    SnapshotPublisher publisher;
+    EXPECT_EQ(publisher.latest()->size(), 0u);
+
+    auto first = publisher.acquire();
+    first->tick = 1;
+    const WorldSnapshot *firstRaw = first.get();
+    publisher.publish(std::move(first));
+
+    std::shared_ptr<const WorldSnapshot> reader = publisher.latest();
+    auto second = publisher.acquire();
+    second->tick = 2;
+    const WorldSnapshot *secondRaw = second.get();
+    publisher.publish(std::move(second));
+
+    // Первый снимок ещё у читателя — буфер для третьего должен быть новым
+    auto third = publisher.acquire();
+    EXPECT_NE(third.get(), firstRaw);
+    EXPECT_EQ(reader->tick, 1u);
+    EXPECT_EQ(publisher.latest()->tick, 2u);
+    publisher.publish(std::move(third));
+
+    // Второй снимок никто не держит — его буфер переиспользуется
+    EXPECT_EQ(publisher.acquire().get(), secondRaw);
+}
+
+TEST(DistanceKernelTest, MaskMatchesDistanceTo)
+{
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<double> pos(0.0, 100.0);
+
+    auto center = NPCFactory::createNPC("Elf", "Center", 50, 50);
+    std::vector<std::shared_ptr<NPC>> others;
+    std::vector<double> xs, ys;
+    for (int i = 0; i < 61; ++i)
+    {
+        others.push_back(NPCFactory::createNPC("Druid", "D" + std::to_string(i), pos(gen), pos(gen)));
+        xs.push_back(others.back()->getX());
+        ys.push_back(others.back()->getY());
+    }
+
+    const double radius = 30.0;
+    uint64_t expected = 0;
+    for (size_t k = 0; k < others.size(); ++k)
+    {
+        if (center->distanceTo(*others[k]) <= radius)
+            expected |= uint64_t(1) << k;
+    }
+
+    for (auto path : {DistanceKernel::Path::Scalar, DistanceKernel::Path::SSE2, DistanceKernel::Path::AVX2})
+    {
+        if (!DistanceKernel::isSupported(path))
+            continue;
+        EXPECT_EQ(DistanceKernel::withinRadiusMask(path, center->getX(), center->getY(),
+                                                   xs.data(), ys.data(), xs.size(), radius),
+                  expected);
+    }
+}
+
+TEST(DistanceKernelTest, RangesMaskUsesLargerRadius)
+{
+    std::vector<double> xs = {5, 20, 40, 60, 80};
+    std::vector<double> ys = {0, 0, 0, 0, 0};
+    std::vector<double> radii = {10, 10, 50, 10, 50};
+
+    for (auto path : {DistanceKernel::Path::Scalar, DistanceKernel::Path::SSE2, DistanceKernel::Path::AVX2})
+    {
+        if (!DistanceKernel::isSupported(path))
+            continue;
+        // Центр (0, 0) с радиусом 10: 5 — в своём радиусе, 40 — в радиусе кандидата (50)
+        EXPECT_EQ(DistanceKernel::withinRangesMask(path, 0, 0, 10, xs.data(), ys.data(), radii.data(), xs.size()),
+                  0b00101u);
+    }
+}
+
+TEST(SpatialHashGridTest, PairsWithinRangeMatchesBruteForce)
+{
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<double> pos(0.0, 200.0);
+    std::vector<double> xs, ys, ranges;
+    for (int i = 0; i < 400; ++i)
+    {
+        xs.push_back(pos(gen));
+        ys.push_back(pos(gen));
+        ranges.push_back(i % 3 == 2 ? 50.0 : 10.0);
+    }
+
+    SpatialHashGrid grid(50.0);
+    grid.build(xs, ys, ranges);
+
+    std::vector<std::pair<size_t, size_t>> expected;
+    for (size_t i = 0; i < xs.size(); ++i)
+    {
+        for (size_t j = i + 1; j < xs.size(); ++j)
+        {
+            double r = std::max(ranges[i], ranges[j]);
+            double dx = xs[i] - xs[j], dy = ys[i] - ys[j];
+            if (dx * dx + dy * dy <= r * r)
+                expected.emplace_back(i, j);
+        }
+    }
+
+    EXPECT_EQ(grid.pairsWithinRange(), expected);
+}
+
+// Тесты вывода кадров в терминал
+TEST(TerminalRendererTest, SendsOnlyChangedCells)
+{
+    TerminalRenderer canvas(3, 10, true);
+    canvas.text(0, 0, "Тик 1");
+    canvas.text(2, 0, "..........");
+
+    // Первый кадр — весь холст с очисткой экрана
+    std::string first = canvas.render();
+    EXPECT_EQ(first.rfind("\x1b[2J", 0), 0u);
+    EXPECT_NE(first.find("Тик 1"), std::string::npos);
+
+    // Тот же кадр — выводить нечего
+    canvas.clear();
+    canvas.text(0, 0, "Тик 1");
+    canvas.text(2, 0, "..........");
+    EXPECT_TRUE(canvas.render().empty());
+
+    // Изменилась одна клетка — курсор к ней и один символ
+    canvas.clear();
+    canvas.text(0, 0, "Тик 1");
+    canvas.text(2, 0, "..........");
+    canvas.put(2, 4, U'K');
+    EXPECT_EQ(canvas.render(), "\x1b" "7\x1b[3;5HK\x1b" "8");
+
+    // Без терминала каждый кадр выводится целиком
+    TerminalRenderer plain(2, 3, false);
+    plain.text(0, 0, "abc");
+    EXPECT_EQ(plain.render(), "abc\n   \n");
+    EXPECT_EQ(plain.render(), "abc\n   \n");
+}
+
+// Тесты карты плотности
+static WorldSnapshot makeSnapshot(std::initializer_list<std::tuple<NPCType, double, double, bool>> rows)
+{
+    WorldSnapshot snapshot;
+    for (const auto &[type, x, y, alive] : rows)
+    {
+        snapshot.types.push_back(type);
+        snapshot.xs.push_back(x);
+        snapshot.ys.push_back(y);
+        snapshot.nameIds.push_back(0);
+        snapshot.alives.push_back(alive ? 1 : 0);
+        snapshot.aliveCount += alive ? 1 : 0;
+    }
+    return snapshot;
+}
+
+TEST(DensityHeatmapTest, CountsAliveNPCsPerTypeAndCell)
+{
+    WorldSnapshot snapshot = makeSnapshot({{NPCType::Knight, 1, 1, true},
+                                           {NPCType::Knight, 4, 4, true},
+                                           {NPCType::Elf, 9, 1, true},
+                                           {NPCType::Druid, 9, 9, false},
+                                           {NPCType::Druid, 10, 10, true}});
+    DensityHeatmap heatmap(2, 2, 10, 10);
+    heatmap.build(snapshot);
+
+    EXPECT_EQ(heatmap.count(NPCType::Knight, 0, 0), 2u);
+    EXPECT_EQ(heatmap.count(NPCType::Elf, 0, 1), 1u);
+    // Мёртвые не считаются, координата на границе карты попадает в крайнюю клетку
+    EXPECT_EQ(heatmap.count(NPCType::Druid, 1, 1), 1u);
+    EXPECT_EQ(heatmap.total(1, 0), 0u);
+    EXPECT_EQ(heatmap.maxCellTotal(), 2u);
+    EXPECT_EQ(heatmap.typeTotal(NPCType::Druid), 1u);
+
+    EXPECT_EQ(heatmap.shade(1, 0), ' ');
+    EXPECT_EQ(heatmap.shade(0, 0), '@');
+    EXPECT_NE(heatmap.shade(0, 1), ' ');
+}
+
+TEST(DensityHeatmapTest, ParallelBuildMatchesSingleThread)
+{
+    WorldSnapshot snapshot;
+    const size_t n = 200000;
+    for (size_t i = 0; i < n; ++i)
+    {
+        snapshot.types.push_back((NPCType)CounterRng::below(NPC_TYPE_COUNT, 3, 0, i, 0));
+        snapshot.xs.push_back(CounterRng::uniform(3, 0, i, 1) * 100);
+        snapshot.ys.push_back(CounterRng::uniform(3, 0, i, 2) * 100);
+        snapshot.nameIds.push_back(0);
+        snapshot.alives.push_back(i % 7 != 0);
+    }
+
+    DensityHeatmap single(16, 8, 100, 100), parallel(16, 8, 100, 100);
+    single.build(snapshot, 1);
+    parallel.build(snapshot, 4);
+
+    size_t sum = 0;
+    for (int row = 0; row < 8; ++row)
+    {
+        for (int col = 0; col < 16; ++col)
+        {
+            for (int type = 0; type < NPC_TYPE_COUNT; ++type)
+                EXPECT_EQ(single.count((NPCType)type, row, col), parallel.count((NPCType)type, row, col));
+            sum += parallel.total(row, col);
+        }
+    }
+    EXPECT_EQ(sum, n - (n + 6) / 7);
+    EXPECT_EQ(single.maxCellTotal(), parallel.maxCellTotal());
+}
+
+TEST(DensityHeatmapTest, WritesNetpbmImages)
+{
+    WorldSnapshot snapshot = makeSnapshot({{NPCType::Knight, 1, 1, true}, {NPCType::Elf, 9, 9, true}});
+    DensityHeatmap heatmap(3, 2, 10, 10);
+    heatmap.build(snapshot);
+
+    const std::string gray = "test_heatmap.pgm", color = "test_heatmap.ppm";
+    ASSERT_TRUE(heatmap.write(gray));
+    ASSERT_TRUE(heatmap.write(color));
+
+    auto read = [](const std::string &filename)
+    {
+        std::ifstream file(filename, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    };
+    const std::string pgm = read(gray), ppm = read(color);
+    std::remove(gray.c_str());
+    std::remove(color.c_str());
+
+    const std::string pgmHeader = "P5\n3 2\n255\n", ppmHeader = "P6\n3 2\n255\n";
+    ASSERT_EQ(pgm.size(), pgmHeader.size() + 6);
+    ASSERT_EQ(ppm.size(), ppmHeader.size() + 18);
+    EXPECT_EQ(pgm.compare(0, pgmHeader.size(), pgmHeader), 0);
+    EXPECT_EQ(ppm.compare(0, ppmHeader.size(), ppmHeader), 0);
+
+    // Рыцарь в левом верхнем углу — красный канал, эльф в правом нижнем — синий
+    EXPECT_EQ((uint8_t)pgm[pgmHeader.size()], 255);
+    EXPECT_EQ((uint8_t)ppm[ppmHeader.size() + 0], 255);
+    EXPECT_EQ((uint8_t)ppm[ppmHeader.size() + 1], 0);
+    EXPECT_EQ((uint8_t)ppm[ppmHeader.size() + 5 * 3 + 2], 255);
+}
+
+// Тесты метрик
+TEST(MetricsTest, ShardedSeriesSumInExposition)
+{
+    MetricsRegistry registry;
+    Counter &events = registry.counter("test_events_total", "События", "kind=\"a\"");
+    EXPECT_EQ(&events, &registry.counter("test_events_total", "События", "kind=\"a\""));
+    Gauge &depth = registry.gauge("test_depth", "Глубина");
+    Histogram &latency = registry.histogram("test_latency_seconds", "Задержка", {0.1, 1.0});
+    EXPECT_THROW(registry.gauge("test_events_total", "События"), std::logic_error);
+
+    // Потоки пишут в разные сегменты; сумма не теряет событий
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&events]
+                             {
+                                 for (int i = 0; i < 10000; ++i)
+                                     events.add(); });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    EXPECT_EQ(events.value(), 40000u);
+
+    depth.add(5);
+    depth.sub(2);
+    latency.observe(0.05);
+    latency.observe(0.1);
+    latency.observe(0.5);
+    latency.observe(3.0);
+
+    const std::string text = registry.exposition();
+    EXPECT_NE(text.find("# TYPE test_events_total counter\ntest_events_total{kind=\"a\"} 40000\n"), std::string::npos);
+    EXPECT_NE(text.find("test_depth 3\n"), std::string::npos);
+    // Корзины накопительные: le="0.1" включает саму границу
+    EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"0.1\"} 2\n"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"1\"} 3\n"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_bucket{le=\"+Inf\"} 4\n"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_sum 3.65\n"), std::string::npos);
+    EXPECT_NE(text.find("test_latency_seconds_count 4\n"), std::string::npos);
+}
+
+TEST(MetricsTest, QueueAndSubjectUpdateGlobalRegistry)
+{
+    MetricsRegistry &registry = MetricsRegistry::global();
+    Counter &enqueued = registry.counter("dungeon_battle_queue_enqueued_total", "");
+    Counter &dropped = registry.counter("dungeon_battle_queue_dropped_dead_total", "");
+    Counter &elfKills = registry.counter("dungeon_kills_total", "", "type=\"Elf\"");
+    Counter &knightDeaths = registry.counter("dungeon_deaths_total", "", "type=\"Knight\"");
+    const uint64_t enqueuedBefore = enqueued.value(), droppedBefore = dropped.value();
+    const uint64_t killsBefore = elfKills.value(), deathsBefore = knightDeaths.value();
+
+    auto a = NPCFactory::createNPC("Knight", "A", 0, 0);
+    auto b = NPCFactory::createNPC("Elf", "B", 0, 0);
+    auto c = NPCFactory::createNPC("Druid", "C", 0, 0);
+    c->kill();
+    BattleQueue queue;
+    BattleTask tasks[] = {BattleTask(a, b), BattleTask(b, c)};
+    queue.push_n(tasks, 2);
+    EXPECT_EQ(enqueued.value() - enqueuedBefore, 1u);
+    EXPECT_EQ(dropped.value() - droppedBefore, 1u);
+
+    Subject subject;
+    subject.notify(KillEvent{b->getId(), a->getId(), b->getNameId(), a->getNameId(), NPCType::Elf, NPCType::Knight, 6, 1, false, 0});
+    EXPECT_EQ(elfKills.value() - killsBefore, 1u);
+    EXPECT_EQ(knightDeaths.value() - deathsBefore, 1u);
+}
+
+// HTTP-выгрузка есть только на POSIX-системах
+#ifndef _WIN32
+TEST(MetricsExporterTest, WritesFileAndServesHttp)
+{
+    MetricsRegistry registry;
+    registry.counter("test_exported_total", "Выгруженное").add(7);
+
+    const std::string filename = "test_metrics.prom";
+    MetricsExporter exporter(registry, filename, 0, std::chrono::milliseconds(50));
+    ASSERT_TRUE(exporter.start());
+    ASSERT_GT(exporter.port(), 0);
+
+    // HTTP-запрос к локальному порту
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(fd, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((uint16_t)exporter.port());
+    ASSERT_EQ(::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)), 0);
+    const std::string request = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ASSERT_EQ(::send(fd, request.data(), request.size(), 0), (ssize_t)request.size());
+    std::string response;
+    char chunk[1024];
+    ssize_t received;
+    while ((received = ::recv(fd, chunk, sizeof(chunk), 0)) > 0)
+        response.append(chunk, (size_t)received);
+    ::close(fd);
+
+    EXPECT_EQ(response.rfind("HTTP/1.1 200 OK\r\n", 0), 0u);
+    EXPECT_NE(response.find("\r\n\r\n# HELP test_exported_total"), std::string::npos);
+    EXPECT_NE(response.find("test_exported_total 7\n"), std::string::npos);
+
+    // stop() дописывает файл с последними значениями
+    registry.counter("test_exported_total", "Выгруженное").add(1);
+    exporter.stop();
+    std::ifstream file(filename);
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    std::remove(filename.c_str());
+    EXPECT_NE(text.find("test_exported_total 8\n"), std::string::npos);
+}
+#endif
+
+// Тесты хранилища NPC (структура массивов)
+TEST(EntityStoreTest, ColumnsMirrorNPC)
+{
+    EntityStore store;
+    EntityHandle h = store.add(NPCFactory::createNPC("Elf", "E", 12, 34));
+    size_t row = store.rowOf(h);
+
+    EXPECT_DOUBLE_EQ(store.x(row), 12);
+    EXPECT_DOUBLE_EQ(store.y(row), 34);
+    EXPECT_EQ(store.type(row), NPCType::Elf);
+    EXPECT_EQ(store.health(row), store.object(row).getHealth());
+    EXPECT_EQ(store.killRange(row), 50);
+    EXPECT_TRUE(store.isAlive(row));
+
+    store.move(row, 1000, -1000, 100, 100);
+    store.syncObjects();
+    EXPECT_DOUBLE_EQ(store.object(row).getX(), 100);
+    EXPECT_DOUBLE_EQ(store.object(row).getY(), 0);
+}
+
+TEST(EntityStoreTest, HandlesStableAfterCompaction)
+{
+    EntityStore store;
+    EntityHandle a = store.add(NPCFactory::createNPC("Knight", "A", 1, 1));
+    EntityHandle b = store.add(NPCFactory::createNPC("Druid", "B", 2, 2));
+    EntityHandle c = store.add(NPCFactory::createNPC("Elf", "C", 3, 3));
+
+    store.reportDeath(b);
+    store.applyDeaths();
+    EXPECT_FALSE(store.isAlive(store.rowOf(b)));
+
+    std::vector<EntityHandle> removed;
+    store.compact([&](size_t row)
+                  { removed.push_back(store.handleAt(row)); });
+
+    EXPECT_EQ(removed, std::vector<EntityHandle>{b});
+    EXPECT_EQ(store.size(), 2u);
+    EXPECT_FALSE(store.contains(b));
+    EXPECT_EQ(store.object(store.rowOf(a)).getName(), "A");
+    EXPECT_EQ(store.object(store.rowOf(c)).getName(), "C");
+    EXPECT_LT(store.rowOf(a), store.rowOf(c));
+}
+
+TEST(EntityStoreTest, FreedSlotsGetNewGeneration)
+{
+    EntityStore store;
+    EntityHandle a = store.add(NPCFactory::createNPC("Knight", "A", 1, 1));
+    store.setAlive(store.rowOf(a), false);
+    store.compact();
+
+    EntityHandle b = store.add(NPCFactory::createNPC("Elf", "B", 2, 2));
+    EXPECT_EQ(EntityStore::slotOf(b), EntityStore::slotOf(a));
+    EXPECT_NE(b, a);
+    EXPECT_FALSE(store.contains(a));
+    EXPECT_TRUE(store.contains(b));
+
+    // Смерть по устаревшему дескриптору не задевает новую сущность
+    store.reportDeath(a);
+    store.applyDeaths();
+    EXPECT_TRUE(store.isAlive(store.rowOf(b)));
+    EXPECT_EQ(store.slotCount(), 1u);
+}
+
+// Слот с исчерпанными поколениями не выдаётся: старый дескриптор не оживает
+TEST(EntityStoreTest, ExhaustedSlotIsRetired)
+{
+    EntityStore store;
+    EntityHandle first = store.add(NPCFactory::createNPC("Knight", "A", 1, 1));
+    EntityHandle last = first;
+    for (int reuse = 0; reuse < EntityStore::MAX_GENERATION; ++reuse)
+    {
+        store.setAlive(store.rowOf(last), false);
+        store.compact();
+        last = store.add(NPCFactory::createNPC("Knight", "A", 1, 1));
+        ASSERT_EQ(EntityStore::slotOf(last), EntityStore::slotOf(first));
+    }
+    EXPECT_EQ(EntityStore::generationOf(last), EntityStore::MAX_GENERATION);
+
+    store.setAlive(store.rowOf(last), false);
+    store.compact();
+    EntityHandle fresh = store.add(NPCFactory::createNPC("Elf", "B", 2, 2));
+    EXPECT_NE(EntityStore::slotOf(fresh), EntityStore::slotOf(first));
+    EXPECT_FALSE(store.contains(first));
+    EXPECT_FALSE(store.contains(last));
+}
+
+// Воскрешение снимает строку из очереди на удаление
+TEST(EntityStoreTest, ReviveKeepsDeadListConsistent)
+{
+    EntityStore store;
+    std::vector<EntityHandle> handles;
+    for (int i = 0; i < 8; ++i)
+        handles.push_back(store.add(NPCFactory::createNPC("Druid", "D" + std::to_string(i), i, i)));
+    for (int i = 0; i < 8; i += 2)
+        store.setAlive(store.rowOf(handles[i]), false);
+    EXPECT_EQ(store.deadCount(), 4u);
+
+    store.setAlive(store.rowOf(handles[2]), true);
+    EXPECT_EQ(store.deadCount(), 3u);
+    EXPECT_EQ(store.liveCount(), 5u);
+
+    while (store.compactStep(1) > 0)
+    {
+    }
+    EXPECT_EQ(store.size(), 5u);
+    EXPECT_EQ(store.deadCount(), 0u);
+    EXPECT_TRUE(store.contains(handles[2]));
+    EXPECT_TRUE(store.isAlive(store.rowOf(handles[2])));
+    EXPECT_FALSE(store.contains(handles[0]));
+    EXPECT_FALSE(store.contains(handles[6]));
+}
+
+TEST(EntityStoreTest, LiveRowsSkipDeadAndCompactStepIsIncremental)
+{
+    EntityStore store;
+    std::vector<EntityHandle> handles;
+    for (int i = 0; i < 100; ++i)
+        handles.push_back(store.add(NPCFactory::createNPC("Druid", "L" + std::to_string(i), i, i)));
+
+    // 20% мёртвых: ниже порога, строки остаются, но выпадают из списка живых
+    for (int i = 0; i < 20; ++i)
+        store.reportDeath(handles[i * 5]);
+    store.applyDeaths();
+    EXPECT_EQ(store.liveCount(), 80u);
+    for (uint32_t row : store.liveRows())
+        EXPECT_TRUE(store.isAlive(row));
+    EXPECT_EQ(store.compactStep(8), 0u);
+    EXPECT_EQ(store.size(), 100u);
+
+    // Выше порога: удаление порциями до последней мёртвой строки
+    for (int i = 0; i < 20; ++i)
+        store.reportDeath(handles[i * 5 + 1]);
+    store.applyDeaths();
+    size_t removed = 0, steps = 0;
+    while (store.deadCount() > 0)
+    {
+        size_t step = store.compactStep(8);
+        ASSERT_GT(step, 0u);
+        ASSERT_LE(step, 8u);
+        removed += step;
+        ++steps;
+    }
+    EXPECT_EQ(removed, 40u);
+    EXPECT_EQ(steps, 5u);
+    EXPECT_EQ(store.size(), 60u);
+    EXPECT_EQ(store.liveCount(), 60u);
+
+    // Выжившие доступны по прежним дескрипторам
+    for (int i = 0; i < 100; ++i)
+    {
+        bool dead = i % 5 == 0 || i % 5 == 1;
+        ASSERT_EQ(store.contains(handles[i]), !dead);
+        if (!dead)
+        {
+            EXPECT_DOUBLE_EQ(store.x(store.rowOf(handles[i])), i);
+        }
+    }
+}
+
+TEST(EntityStoreTest, LiveRowsDoNotDependOnDeathReportOrder)
+{
+    EntityStore forward, backward;
+    std::vector<EntityHandle> handles;
+    for (int i = 0; i < 20; ++i)
+    {
+        auto npc = NPCFactory::createNPC("Elf", "O" + std::to_string(i), i, i);
+        handles.push_back(forward.add(npc));
+        backward.add(npc);
+    }
+
+    // Потоки боёв сообщают о смертях в произвольном порядке
+    for (int i : {3, 11, 7, 15})
+        forward.reportDeath(handles[i]);
+    for (int i : {15, 7, 11, 3})
+        backward.reportDeath(handles[i]);
+    forward.applyDeaths();
+    backward.applyDeaths();
+
+    EXPECT_EQ(forward.liveCount(), 16u);
+    EXPECT_EQ(forward.liveRows(), backward.liveRows());
+}
+
 // Тесты сериализации
 class SerializationTest : public ::testing::Test
 {